@@ -0,0 +1,62 @@
+// Per pixel luminance statistics of the accumulated frames, and the list of the pixels that still need samples.
+// Must match the constants of adaptive_sampler.h
+
+const int ADAPTIVE_MIN_FRAMES = 16;
+const float ADAPTIVE_MIN_LUMINANCE = 0.01;
+const uint ADAPTIVE_GROUP_SIZE = 64;
+
+// frames, mean and M2 of the luminance (Welford), converged flag
+layout(rgba32f, binding = 2) uniform image2D pixelStats;
+
+// The dispatch size of the list comes first, so the buffer is also the indirect dispatch buffer
+layout(std430, binding = 15) buffer ActivePixels {
+    uint activeGroupsX;
+    uint activeGroupsY;
+    uint activeGroupsZ;
+    uint activeCount;
+    uint activePixels[];
+};
+
+// Pixel of this invocation of an 8 x 8 kernel: the entry listIndex of the active list when sampling
+// adaptively (1D dispatch over the list), otherwise gl_GlobalInvocationID (2D dispatch over the image)
+bool getActivePixel(out ivec2 id, out uint listIndex) {
+    if (adaptiveSampling) {
+        listIndex = gl_WorkGroupID.x * ADAPTIVE_GROUP_SIZE + gl_LocalInvocationIndex;
+        if (listIndex >= activeCount) {
+            return false;
+        }
+
+        uint pixelIndex = activePixels[listIndex];
+        id = ivec2(pixelIndex % width, pixelIndex / width);
+        return true;
+    }
+
+    id = ivec2(gl_GlobalInvocationID.xy);
+    listIndex = id.y * width + id.x;
+    return id.x < width && id.y < height;
+}
+
+bool isConverged(vec4 stats) {
+    if (stats.x < ADAPTIVE_MIN_FRAMES) {
+        return false;
+    }
+
+    // standard error of the accumulated mean, relative to the mean
+    float variance = stats.z / (stats.x - 1.0);
+    float relativeError = sqrt(variance / stats.x) / max(stats.y, ADAPTIVE_MIN_LUMINANCE);
+    return relativeError < adaptiveThreshold;
+}
+
+// Adds the mean of the samples of this frame to the statistics of the pixel
+void updatePixelStats(ivec2 id, vec3 color) {
+    float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+
+    vec4 stats = frameCounter == 0 ? vec4(0) : imageLoad(pixelStats, id);
+    stats.x += 1.0;
+    float delta = luminance - stats.y;
+    stats.y += delta / stats.x;
+    stats.z += delta * (luminance - stats.y);
+    stats.w = isConverged(stats) ? 1.0 : 0.0;
+
+    imageStore(pixelStats, id, stats);
+}
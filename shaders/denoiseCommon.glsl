@@ -0,0 +1,25 @@
+// Edge-avoiding à-trous wavelet filter over the demodulated illumination (SVGF, Schied et al. 2017).
+// Included after gBufferCommon.glsl
+
+// Below this history length the variance is estimated spatially
+const float DENOISE_MIN_HISTORY = 4.0;
+const float DENOISE_MIN_ALBEDO = 0.01;
+
+// Edge-stopping functions
+const float DENOISE_SIGMA_LUMINANCE = 4.0;
+const float DENOISE_SIGMA_NORMAL = 128.0;
+// distance of a neighbour to the plane of the first hit, relative to its distance
+const float DENOISE_SIGMA_PLANE = 0.02;
+
+// rgb: illumination, a: its luminance variance
+layout(rgba32f, binding = 0) uniform image2D inputImage;
+layout(rgba32f, binding = 1) uniform image2D outputImage;
+
+// The illumination is filtered without the albedo of the first hit, so the textures and material edges stay sharp
+vec3 firstHitAlbedo(vec4 firstHitMaterial) {
+    return firstHitMaterial.w < 0 ? vec3(1) : max(firstHitMaterial.rgb, vec3(DENOISE_MIN_ALBEDO));
+}
+
+vec3 firstHitPosition(ivec2 id, vec4 firstHit) {
+    return cameraPosition + cameraDirection(viewMatrix, vec2(id) + 0.5) * firstHit.w;
+}
@@ -0,0 +1,33 @@
+// First hit of the first sample of every pixel, for the passes that run after the path tracer.
+// Included after pathTracingCommon.glsl
+
+// xyz: normal of the first hit facing the camera, w: distance along the camera ray, 0 on a miss
+layout(rgba32f, binding = 3) uniform image2D gBuffer;
+// rgb: albedo of the first hit, w: material ID (see materialId), -1 on a miss
+layout(rgba32f, binding = 5) uniform image2D gBufferMaterial;
+
+// The models have one material each, the spheres come after them
+int materialId(HitRecord hit) {
+    return hit.modelIndex >= 0 ? hit.modelIndex : numberOfModels + hit.primitiveIndex;
+}
+
+void storeFirstHit(ivec2 id, HitRecord hit, HitInfo hitInfo) {
+    imageStore(gBuffer, id, vec4(hitInfo.normal, hitInfo.dist));
+    imageStore(gBufferMaterial, id, vec4(hitInfo.material.color, float(materialId(hit))));
+}
+
+void storeMiss(ivec2 id) {
+    imageStore(gBuffer, id, vec4(0));
+    imageStore(gBufferMaterial, id, vec4(0, 0, 0, -1));
+}
+
+// Same camera model as createRay, through the center of a pixel when pixel is id + 0.5
+vec3 cameraDirection(mat4 view, vec2 pixel) {
+    float aspectRatio = float(width) / float(height);
+    vec2 uv = vec2((pixel.x / float(width) * 2.0 - 1.0) * aspectRatio, pixel.y / float(height) * 2.0 - 1.0);
+    return normalize(transpose(mat3(view)) * vec3(uv, -1));
+}
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
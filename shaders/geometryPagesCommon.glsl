@@ -0,0 +1,128 @@
+// The vertex, index and BVH node buffers, bound in pages when they are larger than the largest storage block
+// of the driver (see GeometryPaging of shader_features.h). Page p holds the elements p << PAGE_SHIFT up to
+// (p + 1) << PAGE_SHIFT of the buffer, page 0 is bound to the usual binding and the other pages follow binding 19.
+// The kernels read the buffers through VERTEX(i), FACE(i) and BVH_NODE(i), which index the buffer directly
+// when it fits in one page. Must match MAX_GEOMETRY_PAGES and the bindings of shader_features.h
+
+#ifndef VERTEX_PAGES
+#define VERTEX_PAGES 1
+#define VERTEX_PAGE_SHIFT 0
+#endif
+#ifndef INDEX_PAGES
+#define INDEX_PAGES 1
+#define INDEX_PAGE_SHIFT 0
+#endif
+#ifndef BVH_NODE_PAGES
+#define BVH_NODE_PAGES 1
+#define BVH_NODE_PAGE_SHIFT 0
+#endif
+
+layout(std430, binding = 3) buffer Vertices {
+    Vertex vertices[];
+};
+
+layout(std430, binding = 4) buffer Indices {
+    ivec4 indices[];
+};
+
+layout(std430, binding = 6) buffer BVHNodes {
+    BVHNode bvhNodes[];
+};
+
+// The blocks of a page cannot be indexed with a varying page number, so the accessors branch on it
+
+#if VERTEX_PAGES > 1
+layout(std430, binding = 19) buffer VertexPage1 {
+    Vertex vertexPage1[];
+};
+#if VERTEX_PAGES > 2
+layout(std430, binding = 20) buffer VertexPage2 {
+    Vertex vertexPage2[];
+};
+#endif
+#if VERTEX_PAGES > 3
+layout(std430, binding = 21) buffer VertexPage3 {
+    Vertex vertexPage3[];
+};
+#endif
+
+Vertex getVertex(int i) {
+    int page = i >> VERTEX_PAGE_SHIFT;
+    int local = i & ((1 << VERTEX_PAGE_SHIFT) - 1);
+#if VERTEX_PAGES > 3
+    if (page == 3) return vertexPage3[local];
+#endif
+#if VERTEX_PAGES > 2
+    if (page == 2) return vertexPage2[local];
+#endif
+    if (page == 1) return vertexPage1[local];
+    return vertices[local];
+}
+#define VERTEX(i) getVertex(i)
+#else
+#define VERTEX(i) vertices[i]
+#endif
+
+#if INDEX_PAGES > 1
+layout(std430, binding = 22) buffer IndexPage1 {
+    ivec4 indexPage1[];
+};
+#if INDEX_PAGES > 2
+layout(std430, binding = 23) buffer IndexPage2 {
+    ivec4 indexPage2[];
+};
+#endif
+#if INDEX_PAGES > 3
+layout(std430, binding = 24) buffer IndexPage3 {
+    ivec4 indexPage3[];
+};
+#endif
+
+ivec4 getFace(int i) {
+    int page = i >> INDEX_PAGE_SHIFT;
+    int local = i & ((1 << INDEX_PAGE_SHIFT) - 1);
+#if INDEX_PAGES > 3
+    if (page == 3) return indexPage3[local];
+#endif
+#if INDEX_PAGES > 2
+    if (page == 2) return indexPage2[local];
+#endif
+    if (page == 1) return indexPage1[local];
+    return indices[local];
+}
+#define FACE(i) getFace(i)
+#else
+#define FACE(i) indices[i]
+#endif
+
+#if BVH_NODE_PAGES > 1
+layout(std430, binding = 25) buffer BVHNodePage1 {
+    BVHNode bvhNodePage1[];
+};
+#if BVH_NODE_PAGES > 2
+layout(std430, binding = 26) buffer BVHNodePage2 {
+    BVHNode bvhNodePage2[];
+};
+#endif
+#if BVH_NODE_PAGES > 3
+layout(std430, binding = 27) buffer BVHNodePage3 {
+    BVHNode bvhNodePage3[];
+};
+#endif
+
+BVHNode getBVHNode(int i) {
+    int page = i >> BVH_NODE_PAGE_SHIFT;
+    int local = i & ((1 << BVH_NODE_PAGE_SHIFT) - 1);
+#if BVH_NODE_PAGES > 3
+    if (page == 3) return bvhNodePage3[local];
+#endif
+#if BVH_NODE_PAGES > 2
+    if (page == 2) return bvhNodePage2[local];
+#endif
+    if (page == 1) return bvhNodePage1[local];
+    return bvhNodes[local];
+}
+#define BVH_NODE(i) getBVHNode(i)
+#else
+#define BVH_NODE(i) bvhNodes[i]
+#endif
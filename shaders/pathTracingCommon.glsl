@@ -0,0 +1,648 @@
+// Structs, buffers and functions shared by the path tracing kernels.
+// Expanded in place of #include "pathTracingCommon.glsl" by ComputeShader.
+
+const int MAX_DEPTH = 10;
+
+const int LIGHT_TRIANGLE = 0;
+const int LIGHT_SPHERE = 1;
+const vec3 BG_COLOR = vec3(0);
+
+const float EPSILON = 0.00001;
+const float SHADOW_EPSILON = 0.001;
+const float PI = 3.14159265;
+
+const float MAX_INT = 4294967295.0f;
+
+// Scene features, defined by Scene when it compiles the kernels (see shader_features.h).
+// Without them every feature is compiled in.
+#ifndef HAS_SPHERES
+#define HAS_SPHERES 1
+#endif
+#ifndef HAS_REFRACTION
+#define HAS_REFRACTION 1
+#endif
+// largest face count of the BVH leaves, 0 when unknown
+#ifndef MAX_LEAF_FACES
+#define MAX_LEAF_FACES 0
+#endif
+
+// Counts the BVH work of the invocation in traversalCost, see traversalStatsCommon.glsl
+#ifndef TRAVERSAL_STATS
+#define TRAVERSAL_STATS 0
+#endif
+
+#if TRAVERSAL_STATS
+#include "traversalStatsCommon.glsl"
+uvec4 traversalCost = uvec4(0);
+#define COUNT_TRAVERSAL(component) traversalCost.component++
+#else
+#define COUNT_TRAVERSAL(component)
+#endif
+
+// Leaf loops run over k < LEAF_LOOP_COUNT(n) and stop at n, a constant bound lets the compiler unroll them
+#if MAX_LEAF_FACES > 0
+#define LEAF_LOOP_COUNT(faceCount) MAX_LEAF_FACES
+#else
+#define LEAF_LOOP_COUNT(faceCount) (faceCount)
+#endif
+
+/*------------*
+|   STRUCTS   |
+*-------------*/
+
+struct Material {
+    vec3 color;
+    float smoothness; 
+    vec3 emissionColor;
+    float emissionStrength;
+    vec3 absorption;
+    float absorptionStrength;
+    float refractionProbability;
+    float refractionIndex;
+}; 
+
+struct Sphere {
+    vec3 center;    
+    float radius;
+    Material material;
+};
+
+struct Vertex {
+    vec3 pos;
+    vec3 normal;
+};
+
+struct BVHNode {
+    vec3 minVertPos;
+    int firstFaceIndex;
+    vec3 maxVertPos;
+    int lastFaceIndex;
+    bool isLeaf;
+    int missIndex;
+};
+
+struct ModelInfo {
+    int vertexCount;
+    int indexCount;
+    int materialIndex;
+    int bvhNodeFirstIndex;
+    int bvhNodeLastIndex;
+};
+
+struct Ray {
+    vec3 origin;
+    vec3 direction;
+};
+
+struct Light {
+    vec3 v0;
+    int type;
+    vec3 v1;
+    float cdf;
+    vec3 v2;
+    float area;
+    vec3 emission;
+    float pad;
+};
+
+// A light sample of a diffuse hit, traced after the bounce
+struct ShadowRay {
+    vec3 origin;
+    float dist;
+    vec3 direction;
+    int pathIndex;
+    vec3 contribution;
+    float pad;
+};
+
+// Closest hit of the traversal, the shading data is only built from it by getHitInfo.
+// primitiveIndex is the face index for models and the sphere index for spheres (modelIndex -1), -1 on a miss.
+struct HitRecord {
+    vec2 barycentrics;
+    float dist;
+    int primitiveIndex;
+    int modelIndex;
+    int vertexOffset;
+};
+
+struct HitInfo {
+    float dist;
+    vec3 point;
+    vec3 normal;
+    bool isBackFace;
+    Material material;
+};
+
+/*--------------------*
+|  USER DEFINED DATA  |
+*---------------------*/
+
+
+layout(std430, binding = 2) buffer Spheres {
+    Sphere spheres[];
+};
+
+#include "geometryPagesCommon.glsl"
+
+layout(std430, binding = 5) buffer Materials {
+    Material materials[];
+};
+
+layout(std430, binding = 7) buffer ModelInfos {
+    ModelInfo modelInfos[];
+};
+
+// Emissive triangles and spheres, with the CDF of their areas
+layout(std430, binding = 13) buffer Lights {
+    Light lights[];
+};
+
+// Constants of the frame, written once per frame by FrameConstantsBuffer. Must match FrameConstantsBlock of frame_constants.h
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 viewMatrix;
+    // camera to world, the inverse of viewMatrix
+    mat4 inverseViewMatrix;
+    vec3 cameraPosition;
+    int width;
+    vec3 sceneMin;
+    int height;
+    vec3 sceneMax;
+    int numberOfSpheres;
+
+    int numberOfModels;
+    int numberOfLights;
+    float totalLightArea;
+    int frameCounter;
+
+    bool accumulateFrames;
+    int samplesPerPixel;
+    // Frame number of the sample sequence: the accumulated frame, or a running count while reprojecting
+    int sequenceFrame;
+    // see adaptiveSamplingCommon.glsl
+    bool adaptiveSampling;
+
+    float adaptiveThreshold;
+    // see gBufferCommon.glsl
+    bool writeGBuffer;
+};
+
+/*------------*
+|  FUNCTIONS  |
+*-------------*/
+
+#include "samplingCommon.glsl"
+
+// Index of the sample in the sequence of the pixel, which restarts every frame when sequenceFrame stays 0
+uint sequenceIndex(int sampleNumber) {
+    return uint(sequenceFrame * samplesPerPixel + sampleNumber);
+}
+
+vec3 randomUnitVector(inout SamplerState samplerState) {
+    vec2 u = randomValue2D(samplerState);
+    float z = u.x * 2.0f - 1.0f;
+    float a = u.y * 6.2831;
+    float r = sqrt(1.0f - z * z);
+    float x = r * cos(a);
+    float y = r * sin(a);
+    return vec3(x, y, z);
+}
+
+vec2 getUV(ivec2 id, inout SamplerState samplerState) {
+    float aspectRatio = float(width) / float(height);
+    vec2 jitter = randomValue2D(samplerState);
+    return vec2(((float(id.x + jitter.x) / float(width)) * 2.0 - 1.0) * aspectRatio,
+                (float(id.y + jitter.y) / float(height)) * 2.0 - 1.0);
+}
+
+// Distance to the sphere along the ray, MAX_INT on a miss
+float raySphereIntersection(Ray r, Sphere sphere) {
+    vec3 oc = sphere.center - r.origin;
+    float a = dot(r.direction, r.direction);
+    float b = -2.0f * dot(r.direction, oc);
+    float c = dot(oc, oc) - sphere.radius * sphere.radius;
+    float d = b * b - 4.0f * a * c;
+    if (d >= 0) {
+        float tNear = max(0.0, (-b - sqrt(d)) / (2.0f * a));
+        float tFar = (-b + sqrt(d)) / (2.0f * a);
+        if (tFar > 0.0f) {
+            bool isInside = tNear == 0;
+            return isInside ? tFar : tNear;
+        }
+    }
+
+    return MAX_INT;
+}
+
+// Distance to the triangle along the ray and the barycentrics of p2 and p3, MAX_INT on a miss
+float rayTriangleIntersection(Ray r, vec3 p1, vec3 p2, vec3 p3, out vec2 barycentrics) {
+    vec3 c1 = -r.direction;
+    vec3 c2 = p2 - p1;
+    vec3 c3 = p3 - p1;
+    vec3 c = r.origin - p1;
+
+    vec3 n = cross(c2, c3);
+    vec3 e = cross(c1, c);
+    float d = dot(c1, n); 
+
+    float t = dot(c, n) / d;
+    float u2 =  dot(c3, e) / d;
+    float u3 = dot(-c2, e) / d;
+
+    barycentrics = vec2(u2, u3);
+
+    if (u2 < 0 || u3 < 0 || u2 + u3 > 1 || t <= EPSILON) {
+        return MAX_INT;
+    }
+    return t;
+}
+
+// Whether the ray overlaps the box somewhere in [tMin, tMax]
+bool rayAABBIntersection(Ray ray, vec3 minVertPos, vec3 maxVertPos, float tMin, float tMax) {
+    float tx1 = (minVertPos.x - ray.origin.x) / ray.direction.x;
+    float tx2 = (maxVertPos.x - ray.origin.x) / ray.direction.x;
+    float tmin = min(tx1, tx2);
+    float tmax = max(tx1, tx2);
+    float ty1 = (minVertPos.y - ray.origin.y) / ray.direction.y; 
+    float ty2 = (maxVertPos.y - ray.origin.y) / ray.direction.y;
+    tmin = max(tmin, min(ty1, ty2));
+    tmax = min(tmax, max(ty1, ty2));
+    float tz1 = (minVertPos.z - ray.origin.z) / ray.direction.z;
+    float tz2 = (maxVertPos.z - ray.origin.z) / ray.direction.z;
+    tmin = max(tmin, min(tz1, tz2));
+    tmax = min(tmax, max(tz1, tz2));
+    return tmax >= tmin && tmax > tMin && tmin < tMax;
+}
+
+void traverseBVH(Ray ray, int firstBvhNodeIndex, int lastBvhNodeIndex, int modelIndex, int vertexOffset, inout HitRecord closestHit) {
+    int i = firstBvhNodeIndex;
+    while (i >= 0 && i <= lastBvhNodeIndex) {
+        COUNT_TRAVERSAL(y);
+        if (!rayAABBIntersection(ray, BVH_NODE(i).minVertPos, BVH_NODE(i).maxVertPos, 0.0, closestHit.dist)) {
+            i = BVH_NODE(i).missIndex;
+            continue;
+        }
+        COUNT_TRAVERSAL(x);
+
+        if (BVH_NODE(i).isLeaf) {
+            int firstFaceIndex = BVH_NODE(i).firstFaceIndex;
+            int faceCount = BVH_NODE(i).lastFaceIndex - firstFaceIndex + 1;
+            for (int k = 0; k < LEAF_LOOP_COUNT(faceCount); k++) {
+                if (k >= faceCount) {
+                    break;
+                }
+
+                int j = firstFaceIndex + k;
+                ivec4 face = FACE(j) + vertexOffset;
+                COUNT_TRAVERSAL(z);
+
+                vec2 barycentrics;
+                float dist = rayTriangleIntersection(ray, VERTEX(face.x).pos, VERTEX(face.y).pos, VERTEX(face.z).pos, barycentrics);
+                if (dist < closestHit.dist) {
+                    closestHit = HitRecord(barycentrics, dist, j, modelIndex, vertexOffset);
+                }
+            }
+        }
+
+        i++;
+    }
+}
+
+HitRecord findFirstIntersection(Ray ray) {
+    HitRecord closestHit = HitRecord(vec2(0), MAX_INT, -1, -1, 0);
+
+#if HAS_SPHERES
+    for (int i = 0; i < numberOfSpheres; i++) {
+        float dist = raySphereIntersection(ray, spheres[i]);
+        if (dist < closestHit.dist) {
+            closestHit = HitRecord(vec2(0), dist, i, -1, 0);
+        }
+    }
+#endif
+
+    int vertexOffset = 0;
+
+    for (int i = 0; i < numberOfModels; i++) {
+        traverseBVH(ray, modelInfos[i].bvhNodeFirstIndex, modelInfos[i].bvhNodeLastIndex, i, vertexOffset, closestHit);
+        vertexOffset += modelInfos[i].vertexCount;
+    }
+
+    return closestHit;
+}
+
+// Interpolates the normal and fetches the material of the closest hit, once per bounce
+HitInfo getHitInfo(Ray ray, HitRecord hit) {
+    HitInfo hitInfo;
+    hitInfo.dist = hit.dist;
+    hitInfo.point = ray.origin + hit.dist * ray.direction;
+
+#if HAS_SPHERES
+    if (hit.modelIndex < 0) {
+        Sphere sphere = spheres[hit.primitiveIndex];
+        vec3 outwardNormal = normalize(hitInfo.point - sphere.center);
+
+        hitInfo.isBackFace = dot(ray.direction, outwardNormal) > 0;
+        hitInfo.normal = hitInfo.isBackFace ? -outwardNormal : outwardNormal;
+        hitInfo.material = sphere.material;
+        return hitInfo;
+    }
+#endif
+
+    ivec4 face = FACE(hit.primitiveIndex) + hit.vertexOffset;
+    Vertex t1 = VERTEX(face.x);
+    Vertex t2 = VERTEX(face.y);
+    Vertex t3 = VERTEX(face.z);
+
+    float u1 = 1.0f - hit.barycentrics.x - hit.barycentrics.y;
+    hitInfo.normal = normalize(u1 * t1.normal + hit.barycentrics.x * t2.normal + hit.barycentrics.y * t3.normal);
+
+    if (dot(ray.direction, hitInfo.normal) > 0) {
+        hitInfo.normal = -hitInfo.normal;
+    }
+
+    hitInfo.isBackFace = dot(ray.direction, cross(t2.pos - t1.pos, t3.pos - t1.pos)) > 0;
+    hitInfo.material = materials[hit.modelIndex];
+
+    return hitInfo;
+}
+
+/*---------------*
+|  ANY HIT RAYS  |
+*----------------*/
+
+// The any hit functions only answer whether something lies on the ray within [tMin, tMax]:
+// they read the vertex positions only, and build no HitInfo.
+
+bool raySphereOcclusion(Ray r, Sphere sphere, float tMin, float tMax) {
+    vec3 oc = sphere.center - r.origin;
+    float a = dot(r.direction, r.direction);
+    float b = -2.0f * dot(r.direction, oc);
+    float c = dot(oc, oc) - sphere.radius * sphere.radius;
+    float d = b * b - 4.0f * a * c;
+    if (d < 0) {
+        return false;
+    }
+
+    float tNear = (-b - sqrt(d)) / (2.0f * a);
+    float tFar = (-b + sqrt(d)) / (2.0f * a);
+    return (tNear > tMin && tNear < tMax) || (tFar > tMin && tFar < tMax);
+}
+
+bool rayTriangleOcclusion(Ray r, vec3 p1, vec3 p2, vec3 p3, float tMin, float tMax) {
+    vec3 c1 = -r.direction;
+    vec3 c2 = p2 - p1;
+    vec3 c3 = p3 - p1;
+    vec3 c = r.origin - p1;
+
+    vec3 n = cross(c2, c3);
+    vec3 e = cross(c1, c);
+    float d = dot(c1, n); 
+
+    float t = dot(c, n) / d;
+    float u2 =  dot(c3, e) / d;
+    float u3 = dot(-c2, e) / d;
+
+    return u2 >= 0 && u3 >= 0 && u2 + u3 <= 1 && t > tMin && t < tMax;
+}
+
+bool traverseBVHAnyHit(Ray ray, int firstBvhNodeIndex, int lastBvhNodeIndex, int vertexOffset, float tMin, float tMax) {
+    int i = firstBvhNodeIndex;
+    while (i >= 0 && i <= lastBvhNodeIndex) {
+        COUNT_TRAVERSAL(y);
+        if (!rayAABBIntersection(ray, BVH_NODE(i).minVertPos, BVH_NODE(i).maxVertPos, tMin, tMax)) {
+            i = BVH_NODE(i).missIndex;
+            continue;
+        }
+        COUNT_TRAVERSAL(x);
+
+        if (BVH_NODE(i).isLeaf) {
+            int firstFaceIndex = BVH_NODE(i).firstFaceIndex;
+            int faceCount = BVH_NODE(i).lastFaceIndex - firstFaceIndex + 1;
+            for (int k = 0; k < LEAF_LOOP_COUNT(faceCount); k++) {
+                if (k >= faceCount) {
+                    break;
+                }
+
+                int j = firstFaceIndex + k;
+                ivec4 face = FACE(j) + vertexOffset;
+                COUNT_TRAVERSAL(z);
+                if (rayTriangleOcclusion(ray, VERTEX(face.x).pos, VERTEX(face.y).pos, VERTEX(face.z).pos, tMin, tMax)) {
+                    return true;
+                }
+            }
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+// Returns on the first intersection found in [tMin, tMax], whichever it is
+bool isOccluded(Ray ray, float tMin, float tMax) {
+#if HAS_SPHERES
+    for (int i = 0; i < numberOfSpheres; i++) {
+        if (raySphereOcclusion(ray, spheres[i], tMin, tMax)) {
+            return true;
+        }
+    }
+#endif
+
+    int vertexOffset = 0;
+
+    for (int i = 0; i < numberOfModels; i++) {
+        if (traverseBVHAnyHit(ray, modelInfos[i].bvhNodeFirstIndex, modelInfos[i].bvhNodeLastIndex, vertexOffset, tMin, tMax)) {
+            return true;
+        }
+
+        vertexOffset += modelInfos[i].vertexCount;
+    }
+
+    return false;
+}
+
+Ray createRay(vec2 uv) {
+    Ray ray;
+    ray.origin = cameraPosition;
+
+    ray.direction = normalize(mat3(inverseViewMatrix) * vec3(uv, -1));
+
+    return ray;
+}
+
+vec3 getDiffuseDirection(vec3 surfaceNormal, inout SamplerState samplerState) {
+    return normalize(surfaceNormal + randomUnitVector(samplerState));
+}
+
+vec3 getReflectionDirection(vec3 rayDir, vec3 surfaceNormal) {
+    return normalize(rayDir - 2 * surfaceNormal * dot(surfaceNormal, rayDir));
+}
+
+vec3 getRefractionDirection(vec3 rayDir, vec3 surfaceNormal, float ri) {
+    float cosTheta = min(-dot(rayDir, surfaceNormal), 1.0);
+    vec3 rOutPerpendicular =  ri * (rayDir + cosTheta * surfaceNormal);
+    float perpLength = length(rOutPerpendicular);
+    vec3 rOutParallel = -sqrt(abs(1.0 - perpLength * perpLength)) * surfaceNormal;
+    return rOutPerpendicular + rOutParallel;
+}
+
+// Schlick's approximation
+float reflectance(float cosine, float riIn, float riOut) {
+    float r0 = (riIn - riOut) / (riIn + riOut);
+    r0 = r0 * r0;
+    return r0 + (1 - r0) * pow((1 - cosine), 5);
+}
+
+vec3 reflectOrRefract(Ray ray, HitInfo hitInfo, inout SamplerState samplerState) {
+
+    float refractionIndexBefore = hitInfo.isBackFace ? hitInfo.material.refractionIndex : 1.0;
+    float refractionIndexAfter = hitInfo.isBackFace ? 1.0 : hitInfo.material.refractionIndex;
+
+    float refRatio = refractionIndexBefore / refractionIndexAfter;
+
+    float cosTheta = clamp(dot(-ray.direction, hitInfo.normal), -1.0, 1.0);
+    float sinTheta = max(0.0, sqrt(1.0 - cosTheta * cosTheta));
+
+    bool cannotRefract = refRatio * sinTheta > 1.0;
+    
+    vec3 direction;
+    if (cannotRefract || reflectance(cosTheta, refractionIndexBefore, refractionIndexAfter) > randomValue(samplerState)) {
+        vec3 diffuseDir = getDiffuseDirection(hitInfo.normal, samplerState);
+        vec3 reflectDir = getReflectionDirection(ray.direction, hitInfo.normal);
+        direction = mix(diffuseDir, reflectDir, hitInfo.material.smoothness);
+    } else {
+        direction = getRefractionDirection(ray.direction, hitInfo.normal, refRatio);
+    }
+
+    return normalize(direction);
+}
+
+float powerHeuristic(float pdf, float otherPdf) {
+    return (pdf * pdf) / (pdf * pdf + otherPdf * otherPdf);
+}
+
+int sampleLightIndex(float u) {
+    int first = 0;
+    int last = numberOfLights - 1;
+    while (first < last) {
+        int middle = (first + last) / 2;
+        if (lights[middle].cdf < u) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+// Uniform point on the light, so the area pdf over all the lights is 1 / totalLightArea
+void sampleLightPoint(Light light, inout SamplerState samplerState, out vec3 point, out vec3 normal) {
+    if (light.type == LIGHT_SPHERE) {
+        normal = randomUnitVector(samplerState);
+        point = light.v0 + normal * light.v1.x;
+    } else {
+        vec2 u = randomValue2D(samplerState);
+        float su = sqrt(u.x);
+        float b0 = 1.0 - su;
+        float b1 = u.y * su;
+        point = b0 * light.v0 + b1 * light.v1 + (1.0 - b0 - b1) * light.v2;
+        normal = normalize(cross(light.v1 - light.v0, light.v2 - light.v0));
+    }
+}
+
+// Solid angle pdf of reaching a light point at dist with cosLight through light sampling
+float lightPdf(float dist, float cosLight) {
+    return dist * dist / (max(cosLight, EPSILON) * totalLightArea);
+}
+
+bool isVisible(ShadowRay shadowRay) {
+    Ray ray;
+    ray.origin = shadowRay.origin;
+    ray.direction = shadowRay.direction;
+
+    return !isOccluded(ray, EPSILON, shadowRay.dist * (1.0 - SHADOW_EPSILON));
+}
+
+// Next event estimation of a diffuse hit, weighted against the BSDF sample with MIS
+ShadowRay sampleDirectLight(HitInfo hitInfo, vec3 color, inout SamplerState samplerState) {
+    ShadowRay shadowRay;
+    shadowRay.dist = 0;
+
+    Light light = lights[sampleLightIndex(randomValue(samplerState))];
+
+    vec3 lightPoint;
+    vec3 lightNormal;
+    sampleLightPoint(light, samplerState, lightPoint, lightNormal);
+
+    vec3 toLight = lightPoint - hitInfo.point;
+    float dist = length(toLight);
+    vec3 direction = toLight / dist;
+
+    float cosSurface = dot(hitInfo.normal, direction);
+    float cosLight = abs(dot(lightNormal, direction));
+    if (cosSurface <= 0 || cosLight <= 0) {
+        return shadowRay;
+    }
+
+    float pdfLight = lightPdf(dist, cosLight);
+    float pdfBsdf = cosSurface / PI;
+
+    shadowRay.origin = hitInfo.point + hitInfo.normal * EPSILON;
+    shadowRay.direction = direction;
+    shadowRay.dist = dist;
+    shadowRay.contribution = color * hitInfo.material.color / PI * light.emission * cosSurface / pdfLight 
+                             * powerHeuristic(pdfLight, pdfBsdf);
+    return shadowRay;
+}
+
+// Applies one bounce at hitInfo. Returns false when the path terminates.
+// lastBsdfPdf is the pdf of the previous diffuse bounce, 0 when that bounce did not sample the lights.
+// shadowRay.dist stays 0 when there is no light sample to trace.
+bool scatter(inout Ray ray, HitInfo hitInfo, int depth, inout vec3 color, inout vec3 radiance, 
+             inout float lastBsdfPdf, out ShadowRay shadowRay, inout SamplerState samplerState) {
+    Material mat = hitInfo.material;
+    shadowRay.dist = 0;
+    startBounce(samplerState, depth);
+
+#if HAS_REFRACTION
+    if (mat.refractionProbability > 0) {
+        // Beer's Law
+        if (hitInfo.isBackFace) {
+            color *= exp(-hitInfo.dist * mat.absorption * mat.absorptionStrength);
+        }
+
+        ray.direction = reflectOrRefract(ray, hitInfo, samplerState);
+        ray.origin = hitInfo.point + hitInfo.normal * EPSILON * sign(dot(hitInfo.normal, ray.direction));
+        lastBsdfPdf = 0;
+
+    } else
+#endif
+    {
+        float misWeight = 1.0;
+        if (lastBsdfPdf > 0 && mat.emissionStrength > 0) {
+            misWeight = powerHeuristic(lastBsdfPdf, lightPdf(hitInfo.dist, dot(-ray.direction, hitInfo.normal)));
+        }
+        radiance += color * mat.emissionColor * mat.emissionStrength * misWeight;
+
+        // only pure diffuse surfaces have a BSDF pdf to weight the light samples against
+        bool sampleLights = mat.smoothness == 0 && numberOfLights > 0;
+        if (sampleLights) {
+            shadowRay = sampleDirectLight(hitInfo, color, samplerState);
+        }
+
+        color *= mat.color;
+
+        ray.origin = hitInfo.point + hitInfo.normal * EPSILON;
+        ray.direction = mix(getDiffuseDirection(hitInfo.normal, samplerState), 
+                            getReflectionDirection(ray.direction, hitInfo.normal), 
+                            mat.smoothness);
+        lastBsdfPdf = sampleLights ? max(dot(hitInfo.normal, ray.direction), 0.0) / PI : 0.0;
+    }
+
+    float p = clamp(max(color.x, max(color.y, color.z)), 0.05, 1.0);
+    if (depth > 2 && p < randomValue(samplerState)) {
+        return false;
+    }
+
+    color /= p;
+    return true;
+}
\ No newline at end of file
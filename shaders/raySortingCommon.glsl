@@ -0,0 +1,36 @@
+// Binning of the queued rays by direction octant and origin cell, between the bounces of the wavefront path tracer.
+// histogram -> scan -> scatter is a counting sort on the top RAY_SORT_BIN_BITS bits of the 30 bit ray key.
+
+#include "wavefrontCommon.glsl"
+
+const int RAY_SORT_KEY_BITS = 30;
+const int RAY_SORT_BIN_BITS = 12;
+const int RAY_SORT_BIN_COUNT = 1 << RAY_SORT_BIN_BITS;
+
+layout(std430, binding = 12) buffer RayBins {
+    uint binCounts[RAY_SORT_BIN_COUNT];
+    uint binOffsets[RAY_SORT_BIN_COUNT];
+};
+
+uint expandBits(uint v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// Must match rayKey in ray_sorting.cpp
+uint rayKey(vec3 origin, vec3 direction) {
+    vec3 extent = max(sceneMax - sceneMin, vec3(1e-5));
+    uvec3 cell = uvec3(clamp((origin - sceneMin) / extent, 0.0, 1.0) * 511.0);
+
+    uint morton = (expandBits(cell.x) << 2) | (expandBits(cell.y) << 1) | expandBits(cell.z);
+    uint octant = (direction.x < 0 ? 4u : 0u) | (direction.y < 0 ? 2u : 0u) | (direction.z < 0 ? 1u : 0u);
+
+    return (octant << 27) | morton;
+}
+
+uint rayBin(QueuedRay queued) {
+    return rayKey(queued.origin, queued.direction) >> (RAY_SORT_KEY_BITS - RAY_SORT_BIN_BITS);
+}
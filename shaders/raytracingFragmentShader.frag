@@ -5,7 +5,11 @@ out vec4 FragColor;
 in vec2 UVs;
 
 uniform sampler2D screenTexture;
+// part of the texture covered by the frame
+uniform vec2 uvScale;
 
 void main() {
-    FragColor = texture(screenTexture, UVs);
+    // the texels outside of the frame must not be filtered in
+    vec2 halfTexel = 0.5 / vec2(textureSize(screenTexture, 0));
+    FragColor = texture(screenTexture, clamp(UVs * uvScale, halfTexel, uvScale - halfTexel));
 }
\ No newline at end of file
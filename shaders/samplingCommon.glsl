@@ -0,0 +1,81 @@
+// Owen-scrambled Sobol sampler, indexed by pixel, sample number and dimension.
+// Consecutive pairs of dimensions are the first two Sobol dimensions, each pair with its own
+// shuffle of the sample index and each dimension with its own Owen scrambling (Burley 2020).
+// Must match sampling.cpp, so the CPU backend draws the same samples.
+
+// The pixel jitter takes the first 2 dimensions, every bounce the next SAMPLER_BOUNCE_DIMENSIONS
+const uint SAMPLER_CAMERA_DIMENSIONS = 2;
+const uint SAMPLER_BOUNCE_DIMENSIONS = 8;
+
+struct SamplerState {
+    uint seed;
+    uint sampleIndex;
+    uint dimension;
+};
+
+uint hashValue(uint v) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+    return (word >> 22) ^ word;
+}
+
+uint hashCombine(uint seed, uint v) {
+    return seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+uint laineKarrasPermutation(uint x, uint seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+uint nestedUniformScramble(uint x, uint seed) {
+    return bitfieldReverse(laineKarrasPermutation(bitfieldReverse(x), seed));
+}
+
+// Second Sobol dimension, the first one is bitfieldReverse(index)
+uint sobol1(uint index) {
+    uint result = 0u;
+    for (uint v = 1u << 31; index != 0u; index >>= 1, v ^= v >> 1) {
+        if ((index & 1u) != 0u) {
+            result ^= v;
+        }
+    }
+    return result;
+}
+
+float toUnitFloat(uint x) {
+    return float(x >> 8) / 16777216.0;
+}
+
+SamplerState createSampler(uint pixelIndex, uint sampleIndex, uint dimension) {
+    return SamplerState(hashValue(pixelIndex), sampleIndex, dimension);
+}
+
+// Restarts the dimensions at the first one of the bounce, so a dimension means the same decision in every sample
+void startBounce(inout SamplerState samplerState, int depth) {
+    samplerState.dimension = SAMPLER_CAMERA_DIMENSIONS + uint(depth) * SAMPLER_BOUNCE_DIMENSIONS;
+}
+
+float sampleDimension(SamplerState samplerState, uint dimension) {
+    uint pairSeed = hashCombine(samplerState.seed, dimension >> 1);
+    uint index = nestedUniformScramble(samplerState.sampleIndex, pairSeed);
+    uint x = (dimension & 1u) == 0u ? bitfieldReverse(index) : sobol1(index);
+    return toUnitFloat(nestedUniformScramble(x, hashCombine(samplerState.seed, hashValue(dimension))));
+}
+
+float randomValue(inout SamplerState samplerState) {
+    return sampleDimension(samplerState, samplerState.dimension++);
+}
+
+// A stratified 2D sample, from the next pair of dimensions
+vec2 randomValue2D(inout SamplerState samplerState) {
+    samplerState.dimension += samplerState.dimension & 1u;
+    vec2 value = vec2(sampleDimension(samplerState, samplerState.dimension),
+                      sampleDimension(samplerState, samplerState.dimension + 1u));
+    samplerState.dimension += 2u;
+    return value;
+}
@@ -0,0 +1,7 @@
+// Traversal cost of every pixel over all the rays of its samples in the frame, written by the TRAVERSAL_STATS
+// variant of the megakernel and read by the heatmap. Must match TraversalStats of traversal_stats.h
+
+// x: BVH nodes entered, y: AABB tests, z: triangle tests, w: unused
+layout(std430, binding = 16) buffer TraversalCosts {
+    uvec4 traversalCosts[];
+};
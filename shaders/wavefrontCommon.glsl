@@ -0,0 +1,73 @@
+// Path state, ray queues and counters of the wavefront path tracer.
+// Every stage is a separate dispatch: generate -> (dispatch -> intersect -> shade -> shadow) x MAX_DEPTH -> accumulate.
+
+#include "pathTracingCommon.glsl"
+
+const uint WAVEFRONT_GROUP_SIZE = 64;
+
+/*------------*
+|   STRUCTS   |
+*-------------*/
+
+// The sampler state is not stored, every stage recreates it from the path index, sampleIndex and depth
+struct PathState {
+    vec3 color;
+    float lastBsdfPdf;
+    vec3 radiance;
+    float pad;
+};
+
+struct QueuedRay {
+    vec3 origin;
+    int pathIndex;
+    vec3 direction;
+    int pad;
+};
+
+/*--------------------*
+|  USER DEFINED DATA  |
+*---------------------*/
+
+// A new storage block must be counted in WAVEFRONT_STORAGE_BLOCKS of wavefront_path_tracer.h
+layout(std430, binding = 8) buffer PathStates {
+    PathState pathStates[];
+};
+
+// Two queues of queueCapacity rays each, the current one is read and the other one is filled.
+layout(std430, binding = 9) buffer RayQueues {
+    QueuedRay rayQueue[];
+};
+
+layout(std430, binding = 10) buffer Hits {
+    HitRecord hits[];
+};
+
+layout(std430, binding = 11) buffer WavefrontCounters {
+    uint numGroupsX;
+    uint numGroupsY;
+    uint numGroupsZ;
+    uint queueCount[2];
+    uint shadowQueueCount;
+};
+
+// At most one light sample per queued ray and bounce
+layout(std430, binding = 14) buffer ShadowRays {
+    ShadowRay shadowQueue[];
+};
+
+uniform int queueCapacity;
+uniform int currentQueue;
+uniform int depth;
+uniform int sampleIndex;
+
+/*------------*
+|  FUNCTIONS  |
+*-------------*/
+
+int queueSlot(int queue, uint index) {
+    return queue * queueCapacity + int(index);
+}
+
+SamplerState pathSampler(int pathIndex) {
+    return createSampler(uint(pathIndex), sequenceIndex(sampleIndex), 0);
+}
@@ -0,0 +1,71 @@
+#include "adaptive_sampler.h"
+
+
+static bool isConverged(const glm::vec4& stats, float threshold) {
+    if (stats.x < ADAPTIVE_MIN_FRAMES) {
+        return false;
+    }
+
+    float variance = stats.z / (stats.x - 1.0f);
+    float relativeError = std::sqrt(variance / stats.x) / glm::max(stats.y, ADAPTIVE_MIN_LUMINANCE);
+    return relativeError < threshold;
+}
+
+void updatePixelStats(glm::vec4& stats, glm::vec3 color, int frameCounter, float threshold) {
+    float luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+
+    if (frameCounter == 0) {
+        stats = glm::vec4(0.0f);
+    }
+
+    stats.x += 1.0f;
+    float delta = luminance - stats.y;
+    stats.y += delta / stats.x;
+    stats.z += delta * (luminance - stats.y);
+    stats.w = isConverged(stats, threshold) ? 1.0f : 0.0f;
+}
+
+GLint64 AdaptiveSampler::gpuBytes(unsigned int width, unsigned int height) {
+    return (GLint64)sizeof(glm::vec4) * width * height + (GLint64)sizeof(unsigned int) * (4 + width * height);
+}
+
+AdaptiveSampler::AdaptiveSampler(unsigned int width, unsigned int height) :
+    compactShader("../shaders/adaptiveCompactShader.comp") {
+
+    glGenTextures(1, &pixelStatsTex);
+    glBindTexture(GL_TEXTURE_2D, pixelStatsTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+    // 4 header words (dispatch size and count), then one pixel index per pixel
+    glGenBuffers(1, &activePixelSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, activePixelSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * (4 + width * height), nullptr, GL_DYNAMIC_COPY);
+}
+
+AdaptiveSampler::~AdaptiveSampler() {
+    glDeleteTextures(1, &pixelStatsTex);
+    glDeleteBuffers(1, &activePixelSSBO);
+}
+
+void AdaptiveSampler::update(const FrameConstants& frameConstants) {
+    glBindImageTexture(2, pixelStatsTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, activePixelSSBO);
+
+    unsigned int header[4] = { 0, 1, 1, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, activePixelSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header);
+
+    // the statistics of the last frame must be visible to the compaction
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    compactShader.use();
+    compactShader.dispatchImage(frameConstants.width, frameConstants.height);
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+GLuint AdaptiveSampler::activePixelBuffer() const {
+    return activePixelSSBO;
+}
@@ -0,0 +1,38 @@
+#ifndef ADAPTIVE_SAMPLER_H
+#define ADAPTIVE_SAMPLER_H
+
+#include <glm/glm.hpp>
+
+#include "compute_shader.h"
+#include "frame_constants.h"
+
+
+// Must match the constants of adaptiveSamplingCommon.glsl
+const int ADAPTIVE_MIN_FRAMES = 16;
+const float ADAPTIVE_MIN_LUMINANCE = 0.01f;
+
+// Welford statistics of a pixel: accumulated frames, mean and M2 of the luminance, converged flag
+void updatePixelStats(glm::vec4& stats, glm::vec3 color, int frameCounter, float threshold);
+
+// Keeps the luminance statistics of the accumulated pixels (image unit 2) and, every frame, 
+// the list of the pixels that are not converged yet (binding 15), which the GPU backends dispatch over indirectly.
+class AdaptiveSampler {
+public:
+    // width x height: the largest frame
+    AdaptiveSampler(unsigned int width, unsigned int height);
+    ~AdaptiveSampler();
+    // GPU bytes the constructor allocates for width x height
+    static GLint64 gpuBytes(unsigned int width, unsigned int height);
+
+    // Binds the statistics and rebuilds the active pixel list, the images of the frame must be bound already
+    void update(const FrameConstants& frameConstants);
+    GLuint activePixelBuffer() const;
+
+private:
+    ComputeShader compactShader;
+
+    GLuint pixelStatsTex;
+    GLuint activePixelSSBO;
+};
+
+#endif
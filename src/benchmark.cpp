@@ -0,0 +1,126 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+
+// A loop from the default camera position, turning towards both sides of the scene
+const CameraKeyframe DEFAULT_CAMERA_PATH[] = {
+    { glm::vec3( 0.0f, 0.0f, 2.0f), -90.0f,   0.0f },
+    { glm::vec3( 0.5f, 0.2f, 1.5f), -110.0f, -5.0f },
+    { glm::vec3( 0.0f, 0.3f, 1.0f), -90.0f, -10.0f },
+    { glm::vec3(-0.5f, 0.2f, 1.5f), -70.0f,  -5.0f },
+    { glm::vec3( 0.0f, 0.0f, 2.0f), -90.0f,   0.0f }
+};
+
+Benchmark::Benchmark(const std::string& cameraPathFile, int frames, const std::string& logPath) : 
+    frames(glm::max(1, frames)), frame(0), valid(true) {
+
+    if (cameraPathFile.empty()) {
+        keyframes.assign(std::begin(DEFAULT_CAMERA_PATH), std::end(DEFAULT_CAMERA_PATH));
+    } else {
+        valid = loadCameraPath(cameraPathFile);
+    }
+
+    if (!logPath.empty()) {
+        log.open(logPath);
+        if (!log) {
+            std::cout << "Could not open the benchmark log " << logPath << std::endl;
+            return;
+        }
+
+        log << "frame,ms\n";
+    }
+}
+
+bool Benchmark::loadCameraPath(const std::string& cameraPathFile) {
+    std::ifstream file(cameraPathFile);
+    if (!file) {
+        std::cout << "Could not open the camera path " << cameraPathFile << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        CameraKeyframe keyframe;
+        std::istringstream values(line);
+        if (!(values >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.yaw >> keyframe.pitch)) {
+            std::cout << cameraPathFile << ":" << lineNumber << ": expected \"x y z yaw pitch\"" << std::endl;
+            return false;
+        }
+        keyframes.push_back(keyframe);
+    }
+
+    if (keyframes.empty()) {
+        std::cout << "The camera path " << cameraPathFile << " has no keyframes" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Benchmark::isValid() const {
+    return valid;
+}
+
+bool Benchmark::isDone() const {
+    return frame >= BENCHMARK_WARMUP_FRAMES + frames;
+}
+
+void Benchmark::setCamera(Camera& camera) const {
+    // the last timed frame shows the last keyframe
+    int timedFrame = glm::max(0, frame - BENCHMARK_WARMUP_FRAMES);
+    float t = frames > 1 ? float(timedFrame) / float(frames - 1) * float(keyframes.size() - 1) : 0.0f;
+    int first = glm::min((int)t, (int)keyframes.size() - 1);
+    int second = glm::min(first + 1, (int)keyframes.size() - 1);
+    float blend = t - float(first);
+
+    const CameraKeyframe& a = keyframes[first];
+    const CameraKeyframe& b = keyframes[second];
+    camera.setPose(glm::mix(a.position, b.position, blend), glm::mix(a.yaw, b.yaw, blend), glm::mix(a.pitch, b.pitch, blend));
+}
+
+void Benchmark::addFrame(double ms) {
+    if (frame++ < BENCHMARK_WARMUP_FRAMES) {
+        return;
+    }
+
+    if (log.is_open()) {
+        log << frameTimes.size() << "," << ms << "\n";
+    }
+    frameTimes.push_back(ms);
+}
+
+void Benchmark::printSummary() const {
+    if (frameTimes.empty()) {
+        std::cout << "The benchmark timed no frames" << std::endl;
+        return;
+    }
+
+    std::vector<double> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double p) {
+        return sorted[glm::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+    };
+
+    double total = 0;
+    for (double ms : sorted) {
+        total += ms;
+    }
+
+    std::cout << "Benchmark of " << sorted.size() << " frames (" << BENCHMARK_WARMUP_FRAMES << " warmup frames not counted), "
+              << keyframes.size() << " keyframes" << std::endl;
+    std::cout << "frame time |        min |     median |       mean |        p95 |        p99 |        max" << std::endl;
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "ms         | %10.3f | %10.3f | %10.3f | %10.3f | %10.3f | %10.3f", 
+                  sorted.front(), percentile(0.5), total / sorted.size(), percentile(0.95), percentile(0.99), sorted.back());
+    std::cout << line << std::endl;
+}
@@ -0,0 +1,53 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+
+
+struct CameraKeyframe {
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+// Untimed frames before the timed ones, at the first keyframe: they compile the shaders and create the passes
+const int BENCHMARK_WARMUP_FRAMES = 10;
+
+// A run over a scripted camera path that can be compared across commits and machines: the keyframes are spread
+// evenly over the timed frames and interpolated linearly. The frames are timed from their start until the GPU
+// finished them, written to a CSV log and summed up as the min, median, mean, 95th and 99th percentile and max.
+class Benchmark {
+public:
+    // cameraPathFile: one keyframe "x y z yaw pitch" per line ('#' starts a comment), empty for the default path.
+    // logPath: CSV log of the frame times, empty for no log
+    Benchmark(const std::string& cameraPathFile, int frames, const std::string& logPath);
+
+    // false when the camera path could not be read
+    bool isValid() const;
+    bool isDone() const;
+    // Moves the camera to the pose of the current frame
+    void setCamera(Camera& camera) const;
+    // Time of the current frame, the next frame starts
+    void addFrame(double ms);
+    void printSummary() const;
+
+private:
+    std::vector<CameraKeyframe> keyframes;
+    int frames;
+    // counts the warmup frames too
+    int frame;
+    std::vector<double> frameTimes;
+    std::ofstream log;
+    bool valid;
+
+    bool loadCameraPath(const std::string& cameraPathFile);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "bvh_refinement.h"
+
+#include <chrono>
+
+#include "trace_events.h"
+
+BVHRefinement::BVHRefinement(int modelIndex, std::vector<glm::vec3> vertices, std::vector<std::array<int,3>> faces, 
+                             std::vector<glm::vec3> centroids, int maximumNumberOfFacesPerNode) :
+    modelIndex(modelIndex), maximumNumberOfFacesPerNode(maximumNumberOfFacesPerNode) {
+
+    thread = std::thread(&BVHRefinement::build, this, std::move(vertices), std::move(faces), std::move(centroids));
+}
+
+BVHRefinement::~BVHRefinement() {
+    cancelled = true;
+    thread.join();
+}
+
+bool BVHRefinement::isDone() const {
+    return done.load(std::memory_order_acquire);
+}
+
+int BVHRefinement::getModelIndex() const {
+    return modelIndex;
+}
+
+// the leaves of subdivideModelSAH never hold more faces
+int BVHRefinement::getMaximumLeafFaces() const {
+    return glm::max(maximumNumberOfFacesPerNode, 1);
+}
+
+float BVHRefinement::getBuildMilliseconds() const {
+    return buildMilliseconds;
+}
+
+const std::vector<BVHNode>& BVHRefinement::getNodes() const {
+    return nodes;
+}
+
+const std::vector<glm::ivec4>& BVHRefinement::getIndices() const {
+    return indices;
+}
+
+void BVHRefinement::build(std::vector<glm::vec3> vertices, std::vector<std::array<int,3>> faces, std::vector<glm::vec3> centroids) {
+    TraceScope trace("refine BVH", sizeof(glm::ivec4) * faces.size());
+    auto start = std::chrono::steady_clock::now();
+
+    BVHUtils bvhUtils;
+    std::unique_ptr<BVHTree> bvh = bvhUtils.subdivideModelSAH(faces, centroids, vertices, indices, maximumNumberOfFacesPerNode, &cancelled);
+    if (!bvh) {
+        return;
+    }
+
+    std::vector<glm::vec3>().swap(vertices);
+    std::vector<std::array<int,3>>().swap(faces);
+    std::vector<glm::vec3>().swap(centroids);
+
+    bvh->isRoot = true;
+    bvhUtils.addBVHTreeToBVHNodes(*bvh, -1, false, nodes);
+    bvh.reset();
+
+    buildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    done.store(true, std::memory_order_release);
+}
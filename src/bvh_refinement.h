@@ -0,0 +1,47 @@
+#ifndef BVH_REFINEMENT_H
+#define BVH_REFINEMENT_H
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "model/bvh_utils.h"
+
+
+// Builds the SAH tree of a model on a thread of its own, while the frames are traced through the coarse tree
+// the model was added with. Scene swaps the refined nodes and faces in between two frames once it is done.
+class BVHRefinement {
+public:
+    // The transformed vertex positions, the faces and their centroids of the model
+    BVHRefinement(int modelIndex, std::vector<glm::vec3> vertices, std::vector<std::array<int,3>> faces, 
+                  std::vector<glm::vec3> centroids, int maximumNumberOfFacesPerNode);
+    // Stops the build when it is still running
+    ~BVHRefinement();
+
+    bool isDone() const;
+    int getModelIndex() const;
+    int getMaximumLeafFaces() const;
+    float getBuildMilliseconds() const;
+    // Once done: the nodes with indices relative to the model (a missIndex of -1 leaves the model),
+    // and the faces in the order of the leaves
+    const std::vector<BVHNode>& getNodes() const;
+    const std::vector<glm::ivec4>& getIndices() const;
+
+private:
+    int modelIndex;
+    int maximumNumberOfFacesPerNode;
+    std::vector<BVHNode> nodes;
+    std::vector<glm::ivec4> indices;
+    float buildMilliseconds = 0;
+
+    std::atomic<bool> done{false};
+    std::atomic<bool> cancelled{false};
+    std::thread thread;
+
+    void build(std::vector<glm::vec3> vertices, std::vector<std::array<int,3>> faces, std::vector<glm::vec3> centroids);
+};
+
+#endif
@@ -46,6 +46,8 @@ public:
     glm::mat4 getViewMatrix();
     void processKeyboard(Camera_Movement direction, float deltaTime);
     void processMouseMovement(float xoffset, float yoffset, bool constrainPitch = true);
+    // Places the camera, for scripted camera paths
+    void setPose(glm::vec3 position, float yaw, float pitch);
 
 private:
     void updateCameraVectors();
@@ -1,24 +1,86 @@
 #include "compute_shader.h"
 
-ComputeShader::ComputeShader(const char* computeShaderPath) {
-    std::string computeCode;
-    std::ifstream computeShaderFile;
+std::unordered_map<std::string, unsigned int> ComputeShader::programCache;
+GpuProfiler* ComputeShader::profiler = nullptr;
 
-    computeShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+ComputeShader::ComputeShader(const char* computeShaderPath, const std::vector<std::string>& defines) 
+    : name(std::filesystem::path(computeShaderPath).stem().string()) {
+    std::string key = computeShaderPath;
+    for (const std::string& define : defines) {
+        key += "|" + define;
+    }
 
-    try {
-        computeShaderFile.open(computeShaderPath);
-        std::stringstream computeShaderStream;
+    auto cached = programCache.find(key);
+    if (cached != programCache.end()) {
+        ID = cached->second;
+        findUniformLocations();
+        return;
+    }
 
-        computeShaderStream << computeShaderFile.rdbuf();
-        computeShaderFile.close();
-        computeCode = computeShaderStream.str();
+    std::string traceName = "shader " + name;
+    TraceScope trace(traceName.c_str());
+    std::string computeCode = readShaderFile(computeShaderPath);
+
+    // the defines must come after #version, which has to be the first line
+    std::string defineLines;
+    for (const std::string& define : defines) {
+        defineLines += "#define " + define + "\n";
     }
-    catch (std::ifstream::failure& e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+    size_t versionEnd = computeCode.find('\n', computeCode.find("#version"));
+    computeCode.insert(versionEnd == std::string::npos ? computeCode.size() : versionEnd + 1, defineLines);
+
+    // the defines are part of the code, so they are part of its hash
+    std::string cachePath = binaryCachePath(computeCode);
+    ID = loadProgramBinary(cachePath);
+    if (ID == 0) {
+        TraceScope compileTrace("compile", computeCode.size());
+        ID = compile(computeCode);
+        compileTrace.end();
+        saveProgramBinary(ID, cachePath);
     }
+    programCache[key] = ID;
+    findUniformLocations();
+}
+
+// The uniforms of the default block, the members of the uniform blocks have no location
+void ComputeShader::findUniformLocations() {
+    GLint uniformCount = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::vector<GLchar> name(maxNameLength + 1);
+    for (GLint i = 0; i < uniformCount; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(ID, i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
 
-    const char* computeShaderCode = computeCode.c_str();
+        GLint location = glGetUniformLocation(ID, name.data());
+        if (location >= 0) {
+            uniformLocations[name.data()] = location;
+        }
+    }
+}
+
+// -1 for the uniforms the shader does not use, which glUniform ignores
+GLint ComputeShader::uniformLocation(const std::string& name) const {
+    auto location = uniformLocations.find(name);
+    return location == uniformLocations.end() ? -1 : location->second;
+}
+
+void ComputeShader::deleteCachedPrograms() {
+    for (const auto& [key, program] : programCache) {
+        glDeleteProgram(program);
+    }
+    programCache.clear();
+}
+
+void ComputeShader::setProfiler(GpuProfiler* gpuProfiler) {
+    profiler = gpuProfiler;
+}
+
+unsigned int ComputeShader::compile(const std::string& code) {
+    const char* computeShaderCode = code.c_str();
     unsigned int compute;
 
     compute = glCreateShader(GL_COMPUTE_SHADER);
@@ -26,12 +88,110 @@ ComputeShader::ComputeShader(const char* computeShaderPath) {
     glCompileShader(compute);
     checkCompileErrors(compute, "COMPUTE");
 
-    ID = glCreateProgram();
-    glAttachShader(ID, compute);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
+    unsigned int program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(program, compute);
+    glLinkProgram(program);
+    checkCompileErrors(program, "PROGRAM");
 
     glDeleteShader(compute);
+    return program;
+}
+
+// FNV-1a, the file names must stay the same from one run to the next
+static uint64_t hashString(const std::string& text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// A binary is only valid for the driver that created it
+std::string ComputeShader::binaryCachePath(const std::string& code) {
+    std::string driver;
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        const GLubyte* value = glGetString(name);
+        driver += value ? (const char*)value : "";
+        driver += "|";
+    }
+
+    std::stringstream fileName;
+    fileName << std::hex << hashString(driver + code) << ".bin";
+    return (std::filesystem::path(SHADER_CACHE_DIRECTORY) / fileName.str()).string();
+}
+
+// Returns 0 when there is no binary, or when the driver rejects it
+unsigned int ComputeShader::loadProgramBinary(const std::string& cachePath) {
+    TraceScope trace("loadProgramBinary");
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file) {
+        return 0;
+    }
+
+    GLenum binaryFormat;
+    file.read((char*)&binaryFormat, sizeof(binaryFormat));
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) {
+        return 0;
+    }
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    std::vector<GLint> formats(formatCount);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+    if (std::find(formats.begin(), formats.end(), (GLint)binaryFormat) == formats.end()) {
+        return 0;
+    }
+
+    trace.setBytes(binary.size());
+    unsigned int program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glProgramBinary(program, binaryFormat, binary.data(), (GLsizei)binary.size());
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+void ComputeShader::saveProgramBinary(unsigned int program, const std::string& cachePath) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (formats == 0 || !success) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length == 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum binaryFormat;
+    glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+
+    // written next to the final file first, so an interrupted run never leaves a truncated binary behind
+    std::error_code error;
+    std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary);
+        file.write((const char*)&binaryFormat, sizeof(binaryFormat));
+        file.write(binary.data(), length);
+        if (!file) {
+            std::cout << "Could not write the shader cache file " << tempPath << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, cachePath, error);
 }
 
 void ComputeShader::use() {
@@ -45,24 +205,102 @@ void ComputeShader::dispatch(GLuint num_groups_x​, GLuint num_groups_y​, GLu
         glUseProgram(ID);
     }
 
+    TraceScope trace(name.c_str());
+    if (profiler) {
+        profiler->begin(name);
+    }
     glDispatchCompute(num_groups_x​, num_groups_y​, num_groups_z);
+    if (profiler) {
+        profiler->end();
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void ComputeShader::dispatchIndirect(GLuint indirectBuffer, GLintptr offset) {
+    GLint currentProgram;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+    if (currentProgram != (GLint)ID) {
+        glUseProgram(ID);
+    }
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirectBuffer);
+    TraceScope trace(name.c_str());
+    if (profiler) {
+        profiler->begin(name);
+    }
+    glDispatchComputeIndirect(offset);
+    if (profiler) {
+        profiler->end();
+    }
     glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 }
 
+void ComputeShader::dispatchImage(GLuint width, GLuint height) {
+    dispatch((width + 7) / 8, (height + 7) / 8, 1);
+}
+
 void ComputeShader::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(uniformLocation(name), value);
+}
+
+void ComputeShader::setUint(const std::string& name, unsigned int value) const {
+    glUniform1ui(uniformLocation(name), value);
 }
 
 void ComputeShader::setBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(uniformLocation(name), (int)value);
+}
+
+void ComputeShader::setFloat(const std::string& name, float value) const {
+    glUniform1f(uniformLocation(name), value);
 }
 
 void ComputeShader::setVec3(const std::string& name, const glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(uniformLocation(name), 1, &value[0]);
 }
 
 void ComputeShader::setMat4(const std::string& name, const glm::mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+// Reads a shader file and expands its #include "file" lines, relative to the including file.
+std::string ComputeShader::readShaderFile(const std::filesystem::path& path) {
+    std::string code;
+    std::ifstream shaderFile;
+
+    shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    try {
+        shaderFile.open(path);
+        std::stringstream shaderStream;
+
+        shaderStream << shaderFile.rdbuf();
+        shaderFile.close();
+        code = shaderStream.str();
+    }
+    catch (std::ifstream::failure& e) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << " " << e.what() << std::endl;
+        return code;
+    }
+
+    std::stringstream expanded;
+    std::istringstream lines(code);
+    std::string line;
+
+    while (std::getline(lines, line)) {
+        size_t directive = line.find("#include");
+        if (directive != std::string::npos && line.find_first_not_of(" \t") == directive) {
+            size_t first = line.find('"', directive);
+            size_t last = line.find('"', first + 1);
+            if (first != std::string::npos && last != std::string::npos) {
+                expanded << readShaderFile(path.parent_path() / line.substr(first + 1, last - first - 1)) << "\n";
+                continue;
+            }
+        }
+        expanded << line << "\n";
+    }
+
+    return expanded.str();
 }
 
 void ComputeShader::checkCompileErrors(GLuint shader, std::string type) {
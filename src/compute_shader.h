@@ -4,25 +4,64 @@
 #include "../dependencies/glad.h"
 #include "glm/glm.hpp"
 
+#include "gpu_profiler.h"
+#include "trace_events.h"
+
+#include <cstdint>
 #include <string>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <filesystem>
+
+// Compiled programs are kept here between runs, by hash of their code and of the driver
+const char* const SHADER_CACHE_DIRECTORY = "../shader_cache";
 
 class ComputeShader {
 public:
     unsigned int ID;
+    // file name of the shader, without the extension
+    std::string name;
 
-    ComputeShader(const char* computeShaderPath);
+    // Compiles the variant of the shader with a "#define <entry>" line per entry of defines, right after its #version line.
+    // Every variant is compiled once, later instances share its program, which stays alive until deleteCachedPrograms.
+    // The binary of the program is reused by the next runs, until the code or the driver changes
+    ComputeShader(const char* computeShaderPath, const std::vector<std::string>& defines = {});
+    static void deleteCachedPrograms();
+    // Every dispatch is timed as a pass of the profiler, named after the shader. nullptr stops the timing
+    static void setProfiler(GpuProfiler* gpuProfiler);
 
     void use();
     void dispatch(GLuint num_groups_x​, GLuint num_groups_y​, GLuint num_groups_z​);
+    void dispatchIndirect(GLuint indirectBuffer, GLintptr offset = 0);
+    // One invocation per pixel of a width x height image, for 8 x 8 local sizes. The group counts are
+    // rounded up, so the kernel must skip the invocations outside of the image
+    void dispatchImage(GLuint width, GLuint height);
     void setInt(const std::string& name, int value) const;
+    void setUint(const std::string& name, unsigned int value) const;
     void setBool(const std::string& name, bool value) const;
+    void setFloat(const std::string& name, float value) const;
     void setVec3(const std::string& name, const glm::vec3& value) const;
     void setMat4(const std::string& name, const glm::mat4& mat) const;
 
 private:
+    // programs by shader path and defines
+    static std::unordered_map<std::string, unsigned int> programCache;
+    static GpuProfiler* profiler;
+    // found once the program is linked, so setting a uniform costs no lookup in the driver
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    unsigned int compile(const std::string& code);
+    void findUniformLocations();
+    GLint uniformLocation(const std::string& name) const;
+    std::string binaryCachePath(const std::string& code);
+    unsigned int loadProgramBinary(const std::string& cachePath);
+    void saveProgramBinary(unsigned int program, const std::string& cachePath);
+    std::string readShaderFile(const std::filesystem::path& path);
     void checkCompileErrors(GLuint shader, std::string type);
 };
 
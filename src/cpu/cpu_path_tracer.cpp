@@ -0,0 +1,389 @@
+#include "cpu_path_tracer.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+const float EPSILON = 0.00001f;
+const float SHADOW_EPSILON = 0.001f;
+const float PI = 3.14159265f;
+// no limit, like the closest hit queries of pathTracingCommon.glsl
+const float MAX_RAY_DIST = 4294967295.0f;
+
+// Ports of the shading functions of pathTracingCommon.glsl
+
+static glm::vec3 randomUnitVector(SamplerState& samplerState) {
+    glm::vec2 u = randomValue2D(samplerState);
+    float z = u.x * 2.0f - 1.0f;
+    float a = u.y * 6.2831f;
+    float r = std::sqrt(1.0f - z * z);
+    return glm::vec3(r * std::cos(a), r * std::sin(a), z);
+}
+
+static glm::vec3 getDiffuseDirection(glm::vec3 surfaceNormal, SamplerState& samplerState) {
+    return glm::normalize(surfaceNormal + randomUnitVector(samplerState));
+}
+
+static glm::vec3 getReflectionDirection(glm::vec3 rayDir, glm::vec3 surfaceNormal) {
+    return glm::normalize(rayDir - 2.0f * surfaceNormal * glm::dot(surfaceNormal, rayDir));
+}
+
+static glm::vec3 getRefractionDirection(glm::vec3 rayDir, glm::vec3 surfaceNormal, float ri) {
+    float cosTheta = glm::min(-glm::dot(rayDir, surfaceNormal), 1.0f);
+    glm::vec3 rOutPerpendicular = ri * (rayDir + cosTheta * surfaceNormal);
+    float perpLength = glm::length(rOutPerpendicular);
+    glm::vec3 rOutParallel = -std::sqrt(std::abs(1.0f - perpLength * perpLength)) * surfaceNormal;
+    return rOutPerpendicular + rOutParallel;
+}
+
+// Schlick's approximation
+static float reflectance(float cosine, float riIn, float riOut) {
+    float r0 = (riIn - riOut) / (riIn + riOut);
+    r0 = r0 * r0;
+    return r0 + (1 - r0) * std::pow((1 - cosine), 5.0f);
+}
+
+static glm::vec3 reflectOrRefract(const Ray& ray, const HitInfo& hitInfo, SamplerState& samplerState) {
+    const Material& mat = *hitInfo.material;
+
+    float refractionIndexBefore = hitInfo.isBackFace ? mat.refractionIndex : 1.0f;
+    float refractionIndexAfter = hitInfo.isBackFace ? 1.0f : mat.refractionIndex;
+
+    float refRatio = refractionIndexBefore / refractionIndexAfter;
+
+    float cosTheta = glm::clamp(glm::dot(-ray.direction, hitInfo.normal), -1.0f, 1.0f);
+    float sinTheta = glm::max(0.0f, std::sqrt(1.0f - cosTheta * cosTheta));
+
+    bool cannotRefract = refRatio * sinTheta > 1.0f;
+
+    glm::vec3 direction;
+    if (cannotRefract || reflectance(cosTheta, refractionIndexBefore, refractionIndexAfter) > randomValue(samplerState)) {
+        glm::vec3 diffuseDir = getDiffuseDirection(hitInfo.normal, samplerState);
+        glm::vec3 reflectDir = getReflectionDirection(ray.direction, hitInfo.normal);
+        direction = glm::mix(diffuseDir, reflectDir, mat.smoothness);
+    } else {
+        direction = getRefractionDirection(ray.direction, hitInfo.normal, refRatio);
+    }
+
+    return glm::normalize(direction);
+}
+
+static float powerHeuristic(float pdf, float otherPdf) {
+    return (pdf * pdf) / (pdf * pdf + otherPdf * otherPdf);
+}
+
+static int sampleLightIndex(const std::vector<Light>& lights, float u) {
+    int first = 0;
+    int last = lights.size() - 1;
+    while (first < last) {
+        int middle = (first + last) / 2;
+        if (lights[middle].cdf < u) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+static void sampleLightPoint(const Light& light, SamplerState& samplerState, glm::vec3& point, glm::vec3& normal) {
+    if (light.type == LIGHT_SPHERE) {
+        normal = randomUnitVector(samplerState);
+        point = light.v0 + normal * light.v1.x;
+    } else {
+        glm::vec2 u = randomValue2D(samplerState);
+        float su = std::sqrt(u.x);
+        float b0 = 1.0f - su;
+        float b1 = u.y * su;
+        point = b0 * light.v0 + b1 * light.v1 + (1.0f - b0 - b1) * light.v2;
+        normal = glm::normalize(glm::cross(light.v1 - light.v0, light.v2 - light.v0));
+    }
+}
+
+static float lightPdf(float dist, float cosLight, float totalLightArea) {
+    return dist * dist / (glm::max(cosLight, EPSILON) * totalLightArea);
+}
+
+static bool isVisible(const CpuTraversal& traversal, const ShadowRay& shadowRay, glm::uvec4* cost) {
+    return !traversal.isOccluded({ shadowRay.origin, shadowRay.direction }, EPSILON, shadowRay.dist * (1.0f - SHADOW_EPSILON), cost);
+}
+
+static ShadowRay sampleDirectLight(const std::vector<Light>& lights, float totalLightArea, const HitInfo& hitInfo, 
+                                   glm::vec3 color, SamplerState& samplerState) {
+    ShadowRay shadowRay;
+    shadowRay.dist = 0;
+
+    const Light& light = lights[sampleLightIndex(lights, randomValue(samplerState))];
+
+    glm::vec3 lightPoint;
+    glm::vec3 lightNormal;
+    sampleLightPoint(light, samplerState, lightPoint, lightNormal);
+
+    glm::vec3 toLight = lightPoint - hitInfo.point;
+    float dist = glm::length(toLight);
+    glm::vec3 direction = toLight / dist;
+
+    float cosSurface = glm::dot(hitInfo.normal, direction);
+    float cosLight = std::abs(glm::dot(lightNormal, direction));
+    if (cosSurface <= 0 || cosLight <= 0) {
+        return shadowRay;
+    }
+
+    float pdfLight = lightPdf(dist, cosLight, totalLightArea);
+    float pdfBsdf = cosSurface / PI;
+
+    shadowRay.origin = hitInfo.point + hitInfo.normal * EPSILON;
+    shadowRay.direction = direction;
+    shadowRay.dist = dist;
+    shadowRay.contribution = color * hitInfo.material->color / PI * light.emission * cosSurface / pdfLight 
+                             * powerHeuristic(pdfLight, pdfBsdf);
+    return shadowRay;
+}
+
+static bool scatter(Ray& ray, const HitInfo& hitInfo, int depth, glm::vec3& color, glm::vec3& radiance, 
+                    float& lastBsdfPdf, ShadowRay& shadowRay, SamplerState& samplerState,
+                    const std::vector<Light>& lights, float totalLightArea) {
+    const Material& mat = *hitInfo.material;
+    shadowRay.dist = 0;
+    startBounce(samplerState, depth);
+
+    if (mat.refractionProbability > 0) {
+        // Beer's Law
+        if (hitInfo.isBackFace) {
+            glm::vec3 absorbed = -hitInfo.dist * mat.absorption * mat.absorptionStrength;
+            color *= glm::vec3(std::exp(absorbed.x), std::exp(absorbed.y), std::exp(absorbed.z));
+        }
+
+        ray.direction = reflectOrRefract(ray, hitInfo, samplerState);
+        float side = glm::dot(hitInfo.normal, ray.direction);
+        ray.origin = hitInfo.point + hitInfo.normal * EPSILON * (side > 0 ? 1.0f : (side < 0 ? -1.0f : 0.0f));
+        lastBsdfPdf = 0;
+
+    } else {
+        float misWeight = 1.0f;
+        if (lastBsdfPdf > 0 && mat.emissionStrength > 0) {
+            misWeight = powerHeuristic(lastBsdfPdf, lightPdf(hitInfo.dist, glm::dot(-ray.direction, hitInfo.normal), totalLightArea));
+        }
+        radiance += color * mat.emissionColor * mat.emissionStrength * misWeight;
+
+        bool sampleLights = mat.smoothness == 0 && !lights.empty();
+        if (sampleLights) {
+            shadowRay = sampleDirectLight(lights, totalLightArea, hitInfo, color, samplerState);
+        }
+
+        color *= mat.color;
+
+        ray.origin = hitInfo.point + hitInfo.normal * EPSILON;
+        ray.direction = glm::mix(getDiffuseDirection(hitInfo.normal, samplerState), 
+                                 getReflectionDirection(ray.direction, hitInfo.normal), 
+                                 mat.smoothness);
+        lastBsdfPdf = sampleLights ? glm::max(glm::dot(hitInfo.normal, ray.direction), 0.0f) / PI : 0.0f;
+    }
+
+    float p = glm::clamp(glm::max(color.x, glm::max(color.y, color.z)), 0.05f, 1.0f);
+    if (depth > 2 && p < randomValue(samplerState)) {
+        return false;
+    }
+
+    color /= p;
+    return true;
+}
+
+// Index of the sample in the sequence of the pixel, see sequenceIndex in pathTracingCommon.glsl
+static unsigned int sequenceIndex(const FrameConstants& frameConstants, int sample) {
+    return frameConstants.sequenceFrame * frameConstants.samplesPerPixel + sample;
+}
+
+
+CpuPathTracer::CpuPathTracer(const CpuTraversal& traversal, const std::vector<Light>& lights, unsigned int width, unsigned int height) :
+    traversal(traversal), lights(lights), 
+    pathStates(width * height), frame(width * height, glm::vec4(0.0f)), pixelStats(width * height, glm::vec4(0.0f)), 
+    gBuffer(width * height, glm::vec4(0.0f)), gBufferMaterial(width * height, glm::vec4(0.0f)), traversalCosts(width * height), 
+    raySortingStats("cpu") {
+
+}
+
+const std::vector<glm::vec4>& CpuPathTracer::render(const FrameConstants& frameConstants, bool sortRays) {
+    glm::mat4 inverseView = glm::inverse(frameConstants.viewMatrix);
+    int width = frameConstants.width;
+    int height = frameConstants.height;
+    float aspectRatio = float(width) / float(height);
+
+    if (frameConstants.countTraversal) {
+        std::fill(traversalCosts.begin(), traversalCosts.begin() + width * height, glm::uvec4(0));
+    }
+
+    // the converged pixels are left out, they keep their accumulated color
+    activePixels.clear();
+    for (int i = 0; i < width * height; i++) {
+        if (!frameConstants.adaptiveSampling || frameConstants.frameCounter == 0 || pixelStats[i].w == 0) {
+            activePixels.push_back(i);
+        }
+    }
+
+    for (int sample = 0; sample < frameConstants.samplesPerPixel; sample++) {
+        rayQueue.resize(activePixels.size());
+
+        parallelFor("generate camera rays", activePixels.size(), [&](int /*thread*/, int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                unsigned int pixelIndex = activePixels[i];
+                int x = pixelIndex % width;
+                int y = pixelIndex / width;
+                PathState& path = pathStates[pixelIndex];
+
+                if (sample == 0) {
+                    path.radiance = glm::vec3(0.0f);
+                    if (frameConstants.writeGBuffer) {
+                        gBuffer[pixelIndex] = glm::vec4(0.0f);
+                        gBufferMaterial[pixelIndex] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+                    }
+                }
+                path.color = glm::vec3(1.0f);
+                path.lastBsdfPdf = 0;
+
+                SamplerState samplerState = createSampler(pixelIndex, sequenceIndex(frameConstants, sample), 0);
+                glm::vec2 jitter = randomValue2D(samplerState);
+                glm::vec2 uv(((x + jitter.x) / float(width) * 2.0f - 1.0f) * aspectRatio,
+                             (y + jitter.y) / float(height) * 2.0f - 1.0f);
+                glm::vec3 direction = glm::normalize(glm::vec3(inverseView * glm::vec4(uv.x, uv.y, -1.0f, 0.0f)));
+
+                rayQueue[i] = { frameConstants.cameraPosition, (int)pixelIndex, direction, 0 };
+            }
+        });
+
+        for (int depth = 0; depth < WAVEFRONT_MAX_DEPTH && !rayQueue.empty(); depth++) {
+            double sortMs = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+
+            // camera rays are coherent already
+            if (sortRays && depth > 0) {
+                TraceScope trace("sortRayQueue", sizeof(QueuedRay) * rayQueue.size());
+                sortRayQueue(frameConstants);
+                auto sorted = std::chrono::high_resolution_clock::now();
+                sortMs = std::chrono::duration<double, std::milli>(sorted - start).count();
+                start = sorted;
+            }
+
+            traceRayQueue(frameConstants, sample, depth);
+
+            double traceMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            raySortingStats.addBounce(sortRays, depth, sortMs, traceMs);
+
+            rayQueue.swap(nextRayQueue);
+        }
+    }
+
+    raySortingStats.endFrame(sortRays);
+
+    for (int i : activePixels) {
+        glm::vec3 color = pathStates[i].radiance / float(frameConstants.samplesPerPixel);
+
+        if (frameConstants.adaptiveSampling) {
+            updatePixelStats(pixelStats[i], color, frameConstants.frameCounter, frameConstants.adaptiveThreshold);
+        }
+
+        if (frameConstants.accumulateFrames) {
+            glm::vec3 prev = glm::vec3(frame[i]);
+            color = glm::mix(prev, color, 1.0f / float(frameConstants.frameCounter + 1));
+        }
+
+        frame[i] = glm::vec4(color, 1.0f);
+    }
+
+    return frame;
+}
+
+const std::vector<glm::vec4>& CpuPathTracer::firstHits() const {
+    return gBuffer;
+}
+
+const std::vector<glm::vec4>& CpuPathTracer::firstHitMaterials() const {
+    return gBufferMaterial;
+}
+
+const std::vector<glm::uvec4>& CpuPathTracer::pixelTraversalCosts() const {
+    return traversalCosts;
+}
+
+void CpuPathTracer::captureRays(std::vector<DumpedRay>* rays) {
+    capturedRays = rays;
+}
+
+void CpuPathTracer::sortRayQueue(const FrameConstants& frameConstants) {
+    std::vector<unsigned int> keys(rayQueue.size());
+    for (int i = 0; i < rayQueue.size(); i++) {
+        keys[i] = rayKey(rayQueue[i].origin, rayQueue[i].direction, frameConstants.sceneMin, frameConstants.sceneMax);
+    }
+
+    std::vector<int> order;
+    radixSort(keys, order);
+
+    nextRayQueue.resize(rayQueue.size());
+    for (int i = 0; i < order.size(); i++) {
+        nextRayQueue[i] = rayQueue[order[i]];
+    }
+    rayQueue.swap(nextRayQueue);
+}
+
+// Intersects and shades the current queue, the surviving rays are compacted into nextRayQueue in order
+void CpuPathTracer::traceRayQueue(const FrameConstants& frameConstants, int sample, int depth) {
+    int threadCount = glm::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<std::vector<QueuedRay>> survivors(threadCount);
+    std::vector<std::vector<DumpedRay>> threadRays(capturedRays ? threadCount : 0);
+
+    parallelFor("trace ray queue", rayQueue.size(), [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const QueuedRay& queued = rayQueue[i];
+
+            // every pixel has one ray in the queue, so its counters are not shared between the threads
+            glm::uvec4* cost = frameConstants.countTraversal ? &traversalCosts[queued.pathIndex] : nullptr;
+
+            Ray ray = { queued.origin, queued.direction };
+            HitRecord hit = traversal.findFirstIntersection(ray, cost);
+            if (capturedRays) {
+                threadRays[thread].push_back({ ray.origin, 0.0f, ray.direction, MAX_RAY_DIST, RAY_CLOSEST_HIT, queued.pathIndex, { 0, 0 } });
+            }
+
+            if (hit.primitiveIndex < 0) {
+                continue;
+            }
+
+            HitInfo hitInfo = traversal.getHitInfo(ray, hit);
+            if (depth == 0 && sample == 0 && frameConstants.writeGBuffer) {
+                // material ID as in gBufferCommon.glsl
+                int materialId = hit.modelIndex >= 0 ? hit.modelIndex : frameConstants.numberOfModels + hit.primitiveIndex;
+                gBuffer[queued.pathIndex] = glm::vec4(hitInfo.normal, hitInfo.dist);
+                gBufferMaterial[queued.pathIndex] = glm::vec4(hitInfo.material->color, float(materialId));
+            }
+
+            PathState& path = pathStates[queued.pathIndex];
+            ShadowRay shadowRay;
+            SamplerState samplerState = createSampler(queued.pathIndex, sequenceIndex(frameConstants, sample), 0);
+            bool alive = scatter(ray, hitInfo, depth, path.color, path.radiance, path.lastBsdfPdf, shadowRay, samplerState,
+                                 lights, frameConstants.totalLightArea);
+
+            if (shadowRay.dist > 0 && capturedRays) {
+                threadRays[thread].push_back({ shadowRay.origin, EPSILON, shadowRay.direction, shadowRay.dist * (1.0f - SHADOW_EPSILON), 
+                                               RAY_SHADOW, queued.pathIndex, { 0, 0 } });
+            }
+
+            if (shadowRay.dist > 0 && isVisible(traversal, shadowRay, cost)) {
+                path.radiance += shadowRay.contribution;
+            }
+
+            if (alive && depth + 1 < WAVEFRONT_MAX_DEPTH) {
+                survivors[thread].push_back({ ray.origin, queued.pathIndex, ray.direction, 0 });
+            }
+        }
+    });
+
+    nextRayQueue.clear();
+    for (const std::vector<QueuedRay>& rays : survivors) {
+        nextRayQueue.insert(nextRayQueue.end(), rays.begin(), rays.end());
+    }
+
+    for (const std::vector<DumpedRay>& rays : threadRays) {
+        capturedRays->insert(capturedRays->end(), rays.begin(), rays.end());
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CPU_PATH_TRACER_H
+#define CPU_PATH_TRACER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "cpu_traversal.h"
+#include "../frame_constants.h"
+#include "../ray_sorting.h"
+#include "../sampling.h"
+#include "../wavefront_path_tracer.h"
+#include "../adaptive_sampler.h"
+#include "../ray_dump.h"
+
+
+// Reference backend that runs the wavefront path tracer on the CPU threads,
+// one bounce of all the pixels at a time.
+class CpuPathTracer {
+public:
+    // width x height: the largest frame
+    CpuPathTracer(const CpuTraversal& traversal, const std::vector<Light>& lights, unsigned int width, unsigned int height);
+
+    // Returns the accumulated RGBA image, ready for upload
+    const std::vector<glm::vec4>& render(const FrameConstants& frameConstants, bool sortRays);
+    // The G-buffer of the last frame rendered with writeGBuffer, laid out like gBufferCommon.glsl
+    const std::vector<glm::vec4>& firstHits() const;
+    const std::vector<glm::vec4>& firstHitMaterials() const;
+    // The BVH work of every pixel in the last frame rendered with countTraversal, laid out like traversalStatsCommon.glsl
+    const std::vector<glm::uvec4>& pixelTraversalCosts() const;
+    // The rays traced by the next frames are appended to rays, until captureRays(nullptr)
+    void captureRays(std::vector<DumpedRay>* rays);
+
+private:
+    const CpuTraversal& traversal;
+    const std::vector<Light>& lights;
+
+    std::vector<PathState> pathStates;
+    std::vector<QueuedRay> rayQueue;
+    std::vector<QueuedRay> nextRayQueue;
+    std::vector<glm::vec4> frame;
+    // Welford statistics of the pixels (see updatePixelStats) and the pixels traced this frame
+    std::vector<glm::vec4> pixelStats;
+    std::vector<int> activePixels;
+    std::vector<glm::vec4> gBuffer;
+    std::vector<glm::vec4> gBufferMaterial;
+    std::vector<glm::uvec4> traversalCosts;
+    std::vector<DumpedRay>* capturedRays = nullptr;
+
+    RaySortingStats raySortingStats;
+
+    void sortRayQueue(const FrameConstants& frameConstants);
+    void traceRayQueue(const FrameConstants& frameConstants, int sample, int depth);
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include "cpu_traversal.h"
+
+const float EPSILON = 0.00001f;
+const float MAX_INT = 4294967295.0f;
+
+CpuTraversal::CpuTraversal(const std::vector<Sphere>& spheres, const std::vector<Vertex>& vertices, 
+                           const std::vector<glm::ivec4>& indices, const std::vector<Material>& materials,
+                           const std::vector<BVHNode>& bvhNodes, const std::vector<ModelInfo>& modelInfos) :
+    spheres(spheres), vertices(vertices), indices(indices), materials(materials), bvhNodes(bvhNodes), modelInfos(modelInfos) {
+
+}
+
+HitRecord CpuTraversal::findFirstIntersection(const Ray& ray, glm::uvec4* cost) const {
+    HitRecord closestHit = { glm::vec2(0.0f), MAX_INT, -1, -1, 0 };
+
+    for (int i = 0; i < spheres.size(); i++) {
+        float dist = raySphereIntersection(ray, spheres[i]);
+        if (dist < closestHit.dist) {
+            closestHit = { glm::vec2(0.0f), dist, i, -1, 0 };
+        }
+    }
+
+    int vertexOffset = 0;
+
+    for (int i = 0; i < modelInfos.size(); i++) {
+        traverseBVH(ray, modelInfos[i].bvhNodeFirstIndex, modelInfos[i].bvhNodeLastIndex, i, vertexOffset, closestHit, cost);
+        vertexOffset += modelInfos[i].vertexCount;
+    }
+
+    return closestHit;
+}
+
+HitInfo CpuTraversal::getHitInfo(const Ray& ray, const HitRecord& hit) const {
+    HitInfo hitInfo;
+    hitInfo.dist = hit.dist;
+    hitInfo.point = ray.origin + hit.dist * ray.direction;
+
+    if (hit.modelIndex < 0) {
+        const Sphere& sphere = spheres[hit.primitiveIndex];
+        glm::vec3 outwardNormal = glm::normalize(hitInfo.point - sphere.center);
+
+        hitInfo.isBackFace = glm::dot(ray.direction, outwardNormal) > 0;
+        hitInfo.normal = hitInfo.isBackFace ? -outwardNormal : outwardNormal;
+        hitInfo.material = &sphere.material;
+        return hitInfo;
+    }
+
+    const glm::ivec4& face = indices[hit.primitiveIndex];
+    const Vertex& t1 = vertices[face.x + hit.vertexOffset];
+    const Vertex& t2 = vertices[face.y + hit.vertexOffset];
+    const Vertex& t3 = vertices[face.z + hit.vertexOffset];
+
+    float u1 = 1.0f - hit.barycentrics.x - hit.barycentrics.y;
+    hitInfo.normal = glm::normalize(u1 * glm::vec3(t1.nX, t1.nY, t1.nZ) + 
+                                    hit.barycentrics.x * glm::vec3(t2.nX, t2.nY, t2.nZ) + 
+                                    hit.barycentrics.y * glm::vec3(t3.nX, t3.nY, t3.nZ));
+
+    if (glm::dot(ray.direction, hitInfo.normal) > 0) {
+        hitInfo.normal = -hitInfo.normal;
+    }
+
+    glm::vec3 p1(t1.x, t1.y, t1.z);
+    glm::vec3 p2(t2.x, t2.y, t2.z);
+    glm::vec3 p3(t3.x, t3.y, t3.z);
+    hitInfo.isBackFace = glm::dot(ray.direction, glm::cross(p2 - p1, p3 - p1)) > 0;
+    hitInfo.material = &materials[hit.modelIndex];
+
+    return hitInfo;
+}
+
+bool CpuTraversal::isOccluded(const Ray& ray, float tMin, float tMax, glm::uvec4* cost) const {
+    for (int i = 0; i < spheres.size(); i++) {
+        if (raySphereOcclusion(ray, spheres[i], tMin, tMax)) {
+            return true;
+        }
+    }
+
+    int vertexOffset = 0;
+
+    for (int i = 0; i < modelInfos.size(); i++) {
+        if (traverseBVHAnyHit(ray, modelInfos[i].bvhNodeFirstIndex, modelInfos[i].bvhNodeLastIndex, vertexOffset, tMin, tMax, cost)) {
+            return true;
+        }
+
+        vertexOffset += modelInfos[i].vertexCount;
+    }
+
+    return false;
+}
+
+float CpuTraversal::raySphereIntersection(const Ray& r, const Sphere& sphere) const {
+    glm::vec3 oc = sphere.center - r.origin;
+    float a = glm::dot(r.direction, r.direction);
+    float b = -2.0f * glm::dot(r.direction, oc);
+    float c = glm::dot(oc, oc) - sphere.radius * sphere.radius;
+    float d = b * b - 4.0f * a * c;
+    if (d >= 0) {
+        float tNear = glm::max(0.0f, (-b - std::sqrt(d)) / (2.0f * a));
+        float tFar = (-b + std::sqrt(d)) / (2.0f * a);
+        if (tFar > 0.0f) {
+            bool isInside = tNear == 0;
+            return isInside ? tFar : tNear;
+        }
+    }
+
+    return MAX_INT;
+}
+
+float CpuTraversal::rayTriangleIntersection(const Ray& r, const Vertex& t1, const Vertex& t2, const Vertex& t3, glm::vec2& barycentrics) const {
+    glm::vec3 p1(t1.x, t1.y, t1.z);
+    glm::vec3 p2(t2.x, t2.y, t2.z);
+    glm::vec3 p3(t3.x, t3.y, t3.z);
+
+    glm::vec3 c1 = -r.direction;
+    glm::vec3 c2 = p2 - p1;
+    glm::vec3 c3 = p3 - p1;
+    glm::vec3 c = r.origin - p1;
+
+    glm::vec3 n = glm::cross(c2, c3);
+    glm::vec3 e = glm::cross(c1, c);
+    float d = glm::dot(c1, n);
+
+    float t = glm::dot(c, n) / d;
+    float u2 = glm::dot(c3, e) / d;
+    float u3 = glm::dot(-c2, e) / d;
+
+    barycentrics = glm::vec2(u2, u3);
+
+    if (u2 < 0 || u3 < 0 || u2 + u3 > 1 || t <= EPSILON) {
+        return MAX_INT;
+    }
+    return t;
+}
+
+bool CpuTraversal::rayAABBIntersection(const Ray& ray, glm::vec3 minVertPos, glm::vec3 maxVertPos, float tMin, float tMax) const {
+    glm::vec3 t1 = (minVertPos - ray.origin) / ray.direction;
+    glm::vec3 t2 = (maxVertPos - ray.origin) / ray.direction;
+    glm::vec3 tNear = glm::min(t1, t2);
+    glm::vec3 tFar = glm::max(t1, t2);
+    float tmin = glm::max(tNear.x, glm::max(tNear.y, tNear.z));
+    float tmax = glm::min(tFar.x, glm::min(tFar.y, tFar.z));
+    return tmax >= tmin && tmax > tMin && tmin < tMax;
+}
+
+void CpuTraversal::traverseBVH(const Ray& ray, int firstBvhNodeIndex, int lastBvhNodeIndex, int modelIndex, int vertexOffset, HitRecord& closestHit,
+                               glm::uvec4* cost) const {
+    int i = firstBvhNodeIndex;
+    while (i >= 0 && i <= lastBvhNodeIndex) {
+        const BVHNode& node = bvhNodes[i];
+
+        if (cost) {
+            cost->y++;
+        }
+        if (!rayAABBIntersection(ray, node.minVertPos, node.maxVertPos, 0.0f, closestHit.dist)) {
+            i = node.missIndex;
+            continue;
+        }
+        if (cost) {
+            cost->x++;
+        }
+
+        if (node.isLeaf) {
+            for (int j = node.firstFaceIndex; j <= node.lastFaceIndex; j++) {
+                if (cost) {
+                    cost->z++;
+                }
+                glm::vec2 barycentrics;
+                float dist = rayTriangleIntersection(ray, vertices[indices[j].x + vertexOffset], vertices[indices[j].y + vertexOffset], 
+                                                     vertices[indices[j].z + vertexOffset], barycentrics);
+                if (dist < closestHit.dist) {
+                    closestHit = { barycentrics, dist, j, modelIndex, vertexOffset };
+                }
+            }
+        }
+
+        i++;
+    }
+}
+
+bool CpuTraversal::raySphereOcclusion(const Ray& r, const Sphere& sphere, float tMin, float tMax) const {
+    glm::vec3 oc = sphere.center - r.origin;
+    float a = glm::dot(r.direction, r.direction);
+    float b = -2.0f * glm::dot(r.direction, oc);
+    float c = glm::dot(oc, oc) - sphere.radius * sphere.radius;
+    float d = b * b - 4.0f * a * c;
+    if (d < 0) {
+        return false;
+    }
+
+    float tNear = (-b - std::sqrt(d)) / (2.0f * a);
+    float tFar = (-b + std::sqrt(d)) / (2.0f * a);
+    return (tNear > tMin && tNear < tMax) || (tFar > tMin && tFar < tMax);
+}
+
+bool CpuTraversal::rayTriangleOcclusion(const Ray& r, const Vertex& t1, const Vertex& t2, const Vertex& t3, float tMin, float tMax) const {
+    glm::vec3 p1(t1.x, t1.y, t1.z);
+    glm::vec3 p2(t2.x, t2.y, t2.z);
+    glm::vec3 p3(t3.x, t3.y, t3.z);
+
+    glm::vec3 c1 = -r.direction;
+    glm::vec3 c2 = p2 - p1;
+    glm::vec3 c3 = p3 - p1;
+    glm::vec3 c = r.origin - p1;
+
+    glm::vec3 n = glm::cross(c2, c3);
+    glm::vec3 e = glm::cross(c1, c);
+    float d = glm::dot(c1, n);
+
+    float t = glm::dot(c, n) / d;
+    float u2 = glm::dot(c3, e) / d;
+    float u3 = glm::dot(-c2, e) / d;
+
+    return u2 >= 0 && u3 >= 0 && u2 + u3 <= 1 && t > tMin && t < tMax;
+}
+
+bool CpuTraversal::traverseBVHAnyHit(const Ray& ray, int firstBvhNodeIndex, int lastBvhNodeIndex, int vertexOffset, float tMin, float tMax,
+                                     glm::uvec4* cost) const {
+    int i = firstBvhNodeIndex;
+    while (i >= 0 && i <= lastBvhNodeIndex) {
+        const BVHNode& node = bvhNodes[i];
+
+        if (cost) {
+            cost->y++;
+        }
+        if (!rayAABBIntersection(ray, node.minVertPos, node.maxVertPos, tMin, tMax)) {
+            i = node.missIndex;
+            continue;
+        }
+        if (cost) {
+            cost->x++;
+        }
+
+        if (node.isLeaf) {
+            for (int j = node.firstFaceIndex; j <= node.lastFaceIndex; j++) {
+                if (cost) {
+                    cost->z++;
+                }
+                if (rayTriangleOcclusion(ray, vertices[indices[j].x + vertexOffset], vertices[indices[j].y + vertexOffset], 
+                                         vertices[indices[j].z + vertexOffset], tMin, tMax)) {
+                    return true;
+                }
+            }
+        }
+
+        i++;
+    }
+
+    return false;
+}
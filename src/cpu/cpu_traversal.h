@@ -0,0 +1,60 @@
+#ifndef CPU_TRAVERSAL_H
+#define CPU_TRAVERSAL_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../model/model.h"
+#include "../model/bvh_utils.h"
+
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+struct HitInfo {
+    float dist;
+    glm::vec3 point;
+    glm::vec3 normal;
+    bool isBackFace;
+    const Material* material;
+};
+
+// C++ port of the intersection functions of pathTracingCommon.glsl, over the host copies of the scene buffers
+class CpuTraversal {
+public:
+    CpuTraversal(const std::vector<Sphere>& spheres, const std::vector<Vertex>& vertices, 
+                 const std::vector<glm::ivec4>& indices, const std::vector<Material>& materials,
+                 const std::vector<BVHNode>& bvhNodes, const std::vector<ModelInfo>& modelInfos);
+
+    // cost, when given, counts the BVH work like traversalCost of pathTracingCommon.glsl:
+    // x: nodes entered, y: AABB tests, z: triangle tests
+    HitRecord findFirstIntersection(const Ray& ray, glm::uvec4* cost = nullptr) const;
+    // Interpolates the normal and fetches the material of the closest hit
+    HitInfo getHitInfo(const Ray& ray, const HitRecord& hit) const;
+    // Any hit query for visibility rays: returns on the first intersection in [tMin, tMax]
+    bool isOccluded(const Ray& ray, float tMin, float tMax, glm::uvec4* cost = nullptr) const;
+
+private:
+    const std::vector<Sphere>& spheres;
+    const std::vector<Vertex>& vertices;
+    const std::vector<glm::ivec4>& indices;
+    const std::vector<Material>& materials;
+    const std::vector<BVHNode>& bvhNodes;
+    const std::vector<ModelInfo>& modelInfos;
+
+    float raySphereIntersection(const Ray& r, const Sphere& sphere) const;
+    float rayTriangleIntersection(const Ray& r, const Vertex& t1, const Vertex& t2, const Vertex& t3, glm::vec2& barycentrics) const;
+    bool rayAABBIntersection(const Ray& ray, glm::vec3 minVertPos, glm::vec3 maxVertPos, float tMin, float tMax) const;
+    void traverseBVH(const Ray& ray, int firstBvhNodeIndex, int lastBvhNodeIndex, int modelIndex, int vertexOffset, HitRecord& closestHit,
+                     glm::uvec4* cost) const;
+
+    bool raySphereOcclusion(const Ray& r, const Sphere& sphere, float tMin, float tMax) const;
+    bool rayTriangleOcclusion(const Ray& r, const Vertex& t1, const Vertex& t2, const Vertex& t3, float tMin, float tMax) const;
+    bool traverseBVHAnyHit(const Ray& ray, int firstBvhNodeIndex, int lastBvhNodeIndex, int vertexOffset, float tMin, float tMax,
+                           glm::uvec4* cost) const;
+};
+
+#endif
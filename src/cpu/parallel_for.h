@@ -0,0 +1,33 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../trace_events.h"
+
+
+// Splits [0, count) into one contiguous range per hardware thread, traced as name on every thread
+template<typename Function>
+void parallelFor(const char* name, int count, Function function) {
+    int threadCount = glm::max(1, (int)std::thread::hardware_concurrency());
+    int chunk = (count + threadCount - 1) / threadCount;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        int begin = glm::min(count, t * chunk);
+        int end = glm::min(count, begin + chunk);
+        threads.emplace_back([name, t, begin, end, &function]() {
+            TraceScope trace(name);
+            function(t, begin, end);
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+#endif
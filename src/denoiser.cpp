@@ -0,0 +1,65 @@
+#include "denoiser.h"
+
+
+GLint64 Denoiser::gpuBytes(unsigned int width, unsigned int height) {
+    return 3 * (GLint64)sizeof(glm::vec4) * width * height;
+}
+
+Denoiser::Denoiser(unsigned int width, unsigned int height) :
+    varianceShader("../shaders/denoiseVarianceShader.comp"), atrousShader("../shaders/denoiseAtrousShader.comp") {
+
+    GLuint textures[3];
+    glGenTextures(3, textures);
+    for (GLuint texture : textures) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        // the output is upscaled when the frame is smaller than the textures
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    }
+
+    illuminationTex[0] = textures[0];
+    illuminationTex[1] = textures[1];
+    outputTex = textures[2];
+}
+
+Denoiser::~Denoiser() {
+    glDeleteTextures(2, illuminationTex);
+    glDeleteTextures(1, &outputTex);
+}
+
+GLuint Denoiser::denoise(const FrameConstants& frameConstants, GLuint frameTex, GLuint momentsTex) {
+    // the frame and the G-buffer must be complete
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    glBindImageTexture(0, frameTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(1, illuminationTex[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    if (momentsTex != 0) {
+        glBindImageTexture(6, momentsTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    }
+
+    varianceShader.use();
+    varianceShader.setBool("temporalMoments", momentsTex != 0);
+    varianceShader.dispatchImage(frameConstants.width, frameConstants.height);
+
+    atrousShader.use();
+
+    for (int i = 0; i < DENOISER_ITERATIONS; i++) {
+        bool last = i == DENOISER_ITERATIONS - 1;
+        GLuint target = last ? outputTex : illuminationTex[(i + 1) % 2];
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        glBindImageTexture(0, illuminationTex[i % 2], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+        glBindImageTexture(1, target, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+        atrousShader.setInt("stepSize", 1 << i);
+        atrousShader.setBool("remodulate", last);
+        atrousShader.dispatchImage(frameConstants.width, frameConstants.height);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    return outputTex;
+}
@@ -0,0 +1,36 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include <glm/glm.hpp>
+
+#include "compute_shader.h"
+#include "frame_constants.h"
+
+
+// Iterations of the à-trous filter, the last one spans 4 * (2^DENOISER_ITERATIONS - 1) + 1 pixels
+const int DENOISER_ITERATIONS = 5;
+
+// Edge-avoiding à-trous wavelet filter (SVGF) over a finished frame, guided by the G-buffer.
+// The frame itself is left untouched, so the accumulation and the reprojection keep the noisy samples.
+class Denoiser {
+public:
+    // width x height: the largest frame
+    Denoiser(unsigned int width, unsigned int height);
+    ~Denoiser();
+    // GPU bytes the constructor allocates for width x height
+    static GLint64 gpuBytes(unsigned int width, unsigned int height);
+
+    // Returns the filtered frameTex, the G-buffer of the frame must be bound already (see GBuffer::bind).
+    // momentsTex: luminance moments of the reprojected history, 0 to estimate the variance spatially only
+    GLuint denoise(const FrameConstants& frameConstants, GLuint frameTex, GLuint momentsTex);
+
+private:
+    ComputeShader varianceShader;
+    ComputeShader atrousShader;
+
+    // ping-pong illumination and variance of the iterations, then the remodulated result
+    GLuint illuminationTex[2];
+    GLuint outputTex;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#include "dynamic_resolution.h"
+
+
+DynamicResolution::DynamicResolution(float targetFrameMs, float minimumScale) : 
+    targetFrameMs(targetFrameMs), minimumScale(minimumScale), scale(1.0f), estimate(1.0f) {
+
+}
+
+float DynamicResolution::update(float frameMs, bool cameraMoving) {
+    float fitted = scale * std::sqrt(targetFrameMs / glm::max(frameMs, 0.1f));
+    estimate = glm::mix(estimate, glm::clamp(fitted, minimumScale, 1.0f), DYNAMIC_RESOLUTION_SMOOTHING);
+
+    if (!cameraMoving) {
+        scale = 1.0f;
+    } else if (std::abs(estimate - scale) >= DYNAMIC_RESOLUTION_STEP) {
+        scale = glm::clamp(std::round(estimate / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP, minimumScale, 1.0f);
+    }
+
+    return scale;
+}
@@ -0,0 +1,32 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+
+// The scale only changes in steps, every change of the frame size restarts the temporal history
+const float DYNAMIC_RESOLUTION_STEP = 0.125f;
+const float DYNAMIC_RESOLUTION_SMOOTHING = 0.25f;
+
+// Frame time controller for the resolution scale while the camera moves: the cost of a frame is taken to
+// grow with its number of pixels, so the scale follows the square root of the frame time budget.
+// The frame is rendered at full resolution while the camera stands still.
+class DynamicResolution {
+public:
+    DynamicResolution(float targetFrameMs, float minimumScale);
+
+    // Scale of the next frame, from the time of the last one
+    float update(float frameMs, bool cameraMoving);
+
+private:
+    float targetFrameMs;
+    float minimumScale;
+
+    // scale of the last frame, and the smoothed scale that would have met the target
+    float scale;
+    float estimate;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "frame_constants.h"
+
+#include <cstring>
+
+
+FrameConstantsBuffer::FrameConstantsBuffer() : mappedSlots(nullptr), fences{}, slot(0), slotInUse(false) {
+    GLint alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    slotSize = (sizeof(FrameConstantsBlock) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+
+    if (GLAD_GL_VERSION_4_4) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, slotSize * FRAME_CONSTANTS_RING_SIZE, nullptr, flags);
+        mappedSlots = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, slotSize * FRAME_CONSTANTS_RING_SIZE, flags);
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, slotSize * FRAME_CONSTANTS_RING_SIZE, nullptr, GL_DYNAMIC_DRAW);
+    }
+}
+
+FrameConstantsBuffer::~FrameConstantsBuffer() {
+    for (GLsync fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+
+    if (mappedSlots) {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+    glDeleteBuffers(1, &ubo);
+}
+
+void FrameConstantsBuffer::upload(const FrameConstants& frameConstants) {
+    FrameConstantsBlock block;
+    block.viewMatrix = frameConstants.viewMatrix;
+    block.inverseViewMatrix = glm::inverse(frameConstants.viewMatrix);
+    block.cameraPosition = frameConstants.cameraPosition;
+    block.width = frameConstants.width;
+    block.sceneMin = frameConstants.sceneMin;
+    block.height = frameConstants.height;
+    block.sceneMax = frameConstants.sceneMax;
+    block.numberOfSpheres = frameConstants.numberOfSpheres;
+    block.numberOfModels = frameConstants.numberOfModels;
+    block.numberOfLights = frameConstants.numberOfLights;
+    block.totalLightArea = frameConstants.totalLightArea;
+    block.frameCounter = frameConstants.frameCounter;
+    block.accumulateFrames = frameConstants.accumulateFrames;
+    block.samplesPerPixel = frameConstants.samplesPerPixel;
+    block.sequenceFrame = frameConstants.sequenceFrame;
+    block.adaptiveSampling = frameConstants.adaptiveSampling;
+    block.adaptiveThreshold = frameConstants.adaptiveThreshold;
+    block.writeGBuffer = frameConstants.writeGBuffer;
+
+    // all the commands of the last frame are issued by now, so its fence follows them
+    if (slotInUse && mappedSlots) {
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    slot = (slot + 1) % FRAME_CONSTANTS_RING_SIZE;
+
+    if (fences[slot]) {
+        while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+    }
+
+    if (mappedSlots) {
+        std::memcpy(mappedSlots + slot * slotSize, &block, sizeof(block));
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, slot * slotSize, sizeof(block), &block);
+    }
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, ubo, slot * slotSize, sizeof(block));
+    slotInUse = true;
+}
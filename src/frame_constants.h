@@ -0,0 +1,84 @@
+#ifndef FRAME_CONSTANTS_H
+#define FRAME_CONSTANTS_H
+
+#include <glm/glm.hpp>
+
+#include "../dependencies/glad.h"
+
+
+struct FrameConstants {
+    glm::vec3 cameraPosition;
+    glm::mat4 viewMatrix;
+    glm::vec3 sceneMin;
+    glm::vec3 sceneMax;
+    int width;
+    int height;
+    int numberOfSpheres;
+    int numberOfModels;
+    int numberOfLights;
+    float totalLightArea;
+    int frameCounter;
+    bool accumulateFrames;
+    int samplesPerPixel;
+    // frame number of the sample sequences, see sequenceIndex in pathTracingCommon.glsl
+    int sequenceFrame;
+    bool adaptiveSampling;
+    float adaptiveThreshold;
+    // the backends store the first hits in the G-buffer (image unit 3)
+    bool writeGBuffer;
+    // the CPU backend counts the BVH work of every pixel, the megakernel has a variant for it (see TraversalStats)
+    bool countTraversal;
+
+};
+
+// std140 mirror of the FrameConstants block of pathTracingCommon.glsl, the bools are 4 byte ints
+struct alignas(16) FrameConstantsBlock {
+    glm::mat4 viewMatrix;
+    glm::mat4 inverseViewMatrix;
+    glm::vec3 cameraPosition;
+    int width;
+    glm::vec3 sceneMin;
+    int height;
+    glm::vec3 sceneMax;
+    int numberOfSpheres;
+
+    int numberOfModels;
+    int numberOfLights;
+    float totalLightArea;
+    int frameCounter;
+
+    int accumulateFrames;
+    int samplesPerPixel;
+    int sequenceFrame;
+    int adaptiveSampling;
+
+    float adaptiveThreshold;
+    int writeGBuffer;
+};
+
+// Uniform buffer binding of the FrameConstants block
+const GLuint FRAME_CONSTANTS_BINDING = 0;
+// Frames that can be in flight before upload waits for the GPU
+const int FRAME_CONSTANTS_RING_SIZE = 3;
+
+// Ring of FrameConstants blocks in one uniform buffer, persistently mapped where glBufferStorage is available (GL 4.4).
+// Every frame writes the next slot, after the fence of the frame that last used it
+class FrameConstantsBuffer {
+public:
+    FrameConstantsBuffer();
+    ~FrameConstantsBuffer();
+
+    // Writes the constants and binds them to FRAME_CONSTANTS_BINDING, once per frame before its first dispatch
+    void upload(const FrameConstants& frameConstants);
+
+private:
+    GLuint ubo;
+    GLsizeiptr slotSize;
+    // null without persistent mapping, the slots are then written with glBufferSubData
+    char* mappedSlots;
+    GLsync fences[FRAME_CONSTANTS_RING_SIZE];
+    int slot;
+    bool slotInUse;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "g_buffer.h"
+
+
+GLint64 GBuffer::gpuBytes(unsigned int width, unsigned int height) {
+    return 3 * (GLint64)sizeof(glm::vec4) * width * height;
+}
+
+GBuffer::GBuffer(unsigned int width, unsigned int height) : currentFirstHit(0) {
+    GLuint textures[3];
+    glGenTextures(3, textures);
+    for (GLuint texture : textures) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    }
+
+    firstHitTex[0] = textures[0];
+    firstHitTex[1] = textures[1];
+    materialTex = textures[2];
+}
+
+GBuffer::~GBuffer() {
+    glDeleteTextures(2, firstHitTex);
+    glDeleteTextures(1, &materialTex);
+}
+
+void GBuffer::bind() {
+    currentFirstHit = 1 - currentFirstHit;
+    glBindImageTexture(3, firstHitTex[currentFirstHit], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(4, firstHitTex[1 - currentFirstHit], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(5, materialTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+}
+
+void GBuffer::upload(const FrameConstants& frameConstants, const std::vector<glm::vec4>& firstHits, 
+                     const std::vector<glm::vec4>& firstHitMaterials) {
+    glBindTexture(GL_TEXTURE_2D, firstHitTex[currentFirstHit]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frameConstants.width, frameConstants.height, GL_RGBA, GL_FLOAT, firstHits.data());
+
+    glBindTexture(GL_TEXTURE_2D, materialTex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frameConstants.width, frameConstants.height, GL_RGBA, GL_FLOAT, firstHitMaterials.data());
+}
@@ -0,0 +1,34 @@
+#ifndef G_BUFFER_H
+#define G_BUFFER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "compute_shader.h"
+#include "frame_constants.h"
+
+
+// First hit of the first sample of every pixel, see gBufferCommon.glsl. The normal and distance are
+// kept for the last frame too (image unit 4), for the reprojection.
+class GBuffer {
+public:
+    // width x height: the largest frame
+    GBuffer(unsigned int width, unsigned int height);
+    ~GBuffer();
+    // GPU bytes the constructor allocates for width x height
+    static GLint64 gpuBytes(unsigned int width, unsigned int height);
+
+    // Makes the G-buffer of this frame the last one, and binds both with the material image (units 3, 4 and 5)
+    void bind();
+    // Fills the G-buffer of this frame from the host, for the CPU backend
+    void upload(const FrameConstants& frameConstants, const std::vector<glm::vec4>& firstHits, 
+                const std::vector<glm::vec4>& firstHitMaterials);
+
+private:
+    GLuint firstHitTex[2];
+    GLuint materialTex;
+    int currentFirstHit;
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "gpu_profiler.h"
+
+#include <cstdio>
+
+
+GpuProfiler::GpuProfiler(const std::string& logPath) : reportFrames(0), droppedFrames(0), currentFrame(-1), frameCount(0), 
+    jsonLog(false), firstLogEntry(true) {
+
+    hasInvocationQueries = GLAD_GL_VERSION_4_6;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount && !hasInvocationQueries; i++) {
+        hasInvocationQueries = std::string((const char*)glGetStringi(GL_EXTENSIONS, i)) == "GL_ARB_pipeline_statistics_query";
+    }
+
+    if (!logPath.empty()) {
+        log.open(logPath);
+        if (!log) {
+            std::cout << "Could not open the profiling log " << logPath << std::endl;
+            return;
+        }
+
+        jsonLog = logPath.size() >= 5 && logPath.compare(logPath.size() - 5, 5, ".json") == 0;
+        log << (jsonLog ? "[\n" : "frame,pass,gpu_ms,cpu_ms,invocations\n");
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (FrameQueries& frame : frames) {
+        for (PassQueries& queries : frame.queries) {
+            glDeleteQueries(1, &queries.startQuery);
+            glDeleteQueries(1, &queries.endQuery);
+            if (hasInvocationQueries) {
+                glDeleteQueries(1, &queries.invocationQuery);
+            }
+        }
+    }
+
+    if (log.is_open() && jsonLog) {
+        log << "\n]\n";
+    }
+}
+
+void GpuProfiler::beginFrame() {
+    if (currentFrame >= 0) {
+        frames[currentFrame].pending = true;
+    }
+
+    currentFrame = (currentFrame + 1) % GPU_PROFILER_FRAMES_IN_FLIGHT;
+
+    FrameQueries& frame = frames[currentFrame];
+    if (frame.pending) {
+        collectFrame(frame);
+    }
+
+    frame.usedQueries = 0;
+    frame.cpuTimes.clear();
+    frame.frame = frameCount++;
+    frame.pending = false;
+}
+
+void GpuProfiler::begin(const std::string& pass) {
+    if (currentFrame < 0) {
+        return;
+    }
+
+    FrameQueries& frame = frames[currentFrame];
+    if (frame.usedQueries == frame.queries.size()) {
+        PassQueries queries = {};
+        glGenQueries(1, &queries.startQuery);
+        glGenQueries(1, &queries.endQuery);
+        if (hasInvocationQueries) {
+            glGenQueries(1, &queries.invocationQuery);
+        }
+        frame.queries.push_back(queries);
+    }
+
+    PassQueries& queries = frame.queries[frame.usedQueries];
+    queries.pass = passIndex(pass);
+
+    // timestamps rather than GL_TIME_ELAPSED, which cannot be nested in the timings of the wavefront stages
+    glQueryCounter(queries.startQuery, GL_TIMESTAMP);
+    if (hasInvocationQueries) {
+        glBeginQuery(GL_COMPUTE_SHADER_INVOCATIONS, queries.invocationQuery);
+    }
+}
+
+void GpuProfiler::end() {
+    if (currentFrame < 0) {
+        return;
+    }
+
+    FrameQueries& frame = frames[currentFrame];
+    if (hasInvocationQueries) {
+        glEndQuery(GL_COMPUTE_SHADER_INVOCATIONS);
+    }
+    glQueryCounter(frame.queries[frame.usedQueries].endQuery, GL_TIMESTAMP);
+    frame.usedQueries++;
+}
+
+void GpuProfiler::addCpuTime(const std::string& pass, double ms) {
+    if (currentFrame >= 0) {
+        frames[currentFrame].cpuTimes.push_back({ passIndex(pass), ms });
+    }
+}
+
+int GpuProfiler::passIndex(const std::string& pass) {
+    auto index = passIndices.find(pass);
+    if (index != passIndices.end()) {
+        return index->second;
+    }
+
+    passNames.push_back(pass);
+    passStats.push_back(PassStats());
+    passIndices[pass] = passNames.size() - 1;
+    return passNames.size() - 1;
+}
+
+// The queries of a target finish in order, so the frame is complete once its last timestamp and its last
+// invocation query are. The invocation queries are a different target, the timestamps say nothing about them
+void GpuProfiler::collectFrame(FrameQueries& frame) {
+    if (frame.usedQueries > 0) {
+        const PassQueries& last = frame.queries[frame.usedQueries - 1];
+        GLint available = 0;
+        glGetQueryObjectiv(last.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available && hasInvocationQueries) {
+            glGetQueryObjectiv(last.invocationQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+        if (!available) {
+            droppedFrames++;
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < frame.usedQueries; i++) {
+        const PassQueries& queries = frame.queries[i];
+
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        GLuint64 invocations = 0;
+        glGetQueryObjectui64v(queries.startQuery, GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries.endQuery, GL_QUERY_RESULT, &end);
+        if (hasInvocationQueries) {
+            glGetQueryObjectui64v(queries.invocationQuery, GL_QUERY_RESULT, &invocations);
+        }
+
+        double gpuMs = (end - start) / 1e6;
+        passStats[queries.pass].gpuMs += gpuMs;
+        passStats[queries.pass].invocations += invocations;
+        writeLogEntry(frame.frame, queries.pass, gpuMs, 0, invocations);
+    }
+
+    for (const auto& [pass, ms] : frame.cpuTimes) {
+        passStats[pass].cpuMs += ms;
+        writeLogEntry(frame.frame, pass, 0, ms, 0);
+    }
+
+    if (++reportFrames == GPU_PROFILER_REPORT_FRAMES) {
+        print();
+    }
+}
+
+void GpuProfiler::writeLogEntry(int frame, int pass, double gpuMs, double cpuMs, GLuint64 invocations) {
+    if (!log.is_open()) {
+        return;
+    }
+
+    char entry[256];
+    if (jsonLog) {
+        std::snprintf(entry, sizeof(entry), "%s{\"frame\": %d, \"pass\": \"%s\", \"gpu_ms\": %.4f, \"cpu_ms\": %.4f, \"invocations\": %llu}",
+                 firstLogEntry ? "" : ",\n", frame, passNames[pass].c_str(), gpuMs, cpuMs, (unsigned long long)invocations);
+    } else {
+        std::snprintf(entry, sizeof(entry), "%d,%s,%.4f,%.4f,%llu\n", frame, passNames[pass].c_str(), gpuMs, cpuMs, (unsigned long long)invocations);
+    }
+
+    log << entry;
+    firstLogEntry = false;
+}
+
+// Average per frame of every pass since the last report
+void GpuProfiler::print() {
+    if (reportFrames == 0) {
+        return;
+    }
+
+    std::cout << "GPU profile, average ms per frame over " << reportFrames << " frames (" << droppedFrames << " dropped)" << std::endl;
+    std::cout << "pass                                 |   gpu ms |   cpu ms | invocations" << std::endl;
+
+    for (size_t i = 0; i < passNames.size(); i++) {
+        PassStats& stats = passStats[i];
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-36s | %8.3f | %8.3f | %11.0f", passNames[i].c_str(), 
+                      stats.gpuMs / reportFrames, stats.cpuMs / reportFrames, stats.invocations / reportFrames);
+        std::cout << line << std::endl;
+        stats = PassStats();
+    }
+
+    reportFrames = 0;
+    droppedFrames = 0;
+}
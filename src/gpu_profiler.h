@@ -0,0 +1,80 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../dependencies/glad.h"
+
+
+// The queries of a frame are read back this many frames later, so reading them never waits for the GPU
+const int GPU_PROFILER_FRAMES_IN_FLIGHT = 4;
+// The averages are printed every GPU_PROFILER_REPORT_FRAMES frames
+const int GPU_PROFILER_REPORT_FRAMES = 100;
+
+// GPU time of the passes of every frame, from timestamps around every dispatch and the present draw, 
+// and their compute shader invocations where pipeline statistics queries are available (GL 4.6).
+// Every frame can be written to a CSV (one row per pass) or JSON (one object per pass) log.
+class GpuProfiler {
+public:
+    // logPath: a .json file for a JSON log, any other name for a CSV log, empty for no log
+    GpuProfiler(const std::string& logPath);
+    ~GpuProfiler();
+
+    // Starts the next frame, and reads back the frame issued GPU_PROFILER_FRAMES_IN_FLIGHT frames ago
+    void beginFrame();
+    // The commands between begin and end count as the pass. Passes are not nested, the same pass can occur several times per frame
+    void begin(const std::string& pass);
+    void end();
+    // A time measured on the CPU, like the swap of the buffers
+    void addCpuTime(const std::string& pass, double ms);
+    void print();
+
+private:
+    struct PassQueries {
+        int pass;
+        GLuint startQuery;
+        GLuint endQuery;
+        GLuint invocationQuery;
+    };
+
+    struct FrameQueries {
+        // queries are created as needed and kept for the next frames of the slot, the first usedQueries are in use
+        std::vector<PassQueries> queries;
+        size_t usedQueries = 0;
+        std::vector<std::pair<int, double>> cpuTimes;
+        int frame = 0;
+        bool pending = false;
+    };
+
+    struct PassStats {
+        double gpuMs = 0;
+        double cpuMs = 0;
+        double invocations = 0;
+    };
+
+    std::vector<std::string> passNames;
+    std::unordered_map<std::string, int> passIndices;
+    // summed since the last report
+    std::vector<PassStats> passStats;
+    int reportFrames;
+    int droppedFrames;
+
+    FrameQueries frames[GPU_PROFILER_FRAMES_IN_FLIGHT];
+    int currentFrame;
+    int frameCount;
+    bool hasInvocationQueries;
+
+    std::ofstream log;
+    bool jsonLog;
+    bool firstLogEntry;
+
+    int passIndex(const std::string& pass);
+    void collectFrame(FrameQueries& frame);
+    void writeLogEntry(int frame, int pass, double gpuMs, double cpuMs, GLuint64 invocations);
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <filesystem>
+#include <string>
+#include <cstdio>
 
 #include "../dependencies/glad.h"
 #include <GLFW/glfw3.h>
@@ -14,10 +16,14 @@
 #include "compute_shader.h"
 #include "camera.h"
 #include "scene.h"
+#include "dynamic_resolution.h"
+#include "gpu_profiler.h"
+#include "benchmark.h"
+#include "trace_events.h"
 
 
 // functions
-void renderRaytracingQuad(Shader shader, GLuint screenTex);
+void renderRaytracingQuad(Shader shader, GLuint screenTex, glm::vec2 uvScale);
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void mouseCallback(GLFWwindow* window, double xpos, double ypos);
 void processInput(GLFWwindow* window);
@@ -25,22 +31,96 @@ void processInput(GLFWwindow* window);
 // settings
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
+// size of the rendered frames, follows the framebuffer unless given with --resolution <width>x<height>
+unsigned int renderWidth = SCR_WIDTH;
+unsigned int renderHeight = SCR_HEIGHT;
+bool fixedRenderResolution = false;
+// frame time the dynamic resolution aims for while the camera moves
+const float TARGET_FRAME_MS = 1000.0f / 30.0f;
 
 // camera
 Camera camera(glm::vec3(0, 0, 2.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+glm::mat4 lastView(0.0f);
 
 bool accumulateFrames = false;
+RenderSettings renderSettings;
 int frameCounter = 0;
+bool dynamicResolution = false;
+// the rays of the next frame are written to RAY_DUMP_PATH, for the RayReplay benchmark
+bool captureRays = false;
+const char* const RAY_DUMP_PATH = "ray_dump.bin";
+DynamicResolution dynamicResolutionController(TARGET_FRAME_MS, MIN_RESOLUTION_SCALE);
 
 // timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 
-int main() {
+int main(int argc, char** argv) {
+    // the passes are only timed with --profile, the log is CSV unless its name ends with .json
+    bool profile = false;
+    std::string profileLogPath;
+    // --benchmark plays a camera path instead of following the inputs, then exits
+    bool benchmarkRun = false;
+    std::string cameraPathFile;
+    int benchmarkFrames = 300;
+    std::string benchmarkLogPath = "benchmark.csv";
+    // --trace records the startup and frame phases on the CPU, for chrome://tracing
+    std::string tracePath;
+    bool releaseHostCopies = false;
+    // --storage-block-size pages the geometry buffers at a smaller size than the limit of the driver,
+    // --model-memory-budget builds the larger models out of core, --progressive-bvh refines their BVHs while rendering
+    SceneOptions sceneOptions;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--resolution" && i + 1 < argc && 
+            sscanf(argv[i + 1], "%ux%u", &renderWidth, &renderHeight) == 2 && renderWidth > 0 && renderHeight > 0) {
+            fixedRenderResolution = true;
+            i++;
+        } else if (std::string(argv[i]) == "--profile") {
+            profile = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                profileLogPath = argv[++i];
+            }
+        } else if (std::string(argv[i]) == "--benchmark") {
+            benchmarkRun = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                cameraPathFile = argv[++i];
+            }
+        } else if (std::string(argv[i]) == "--frames" && i + 1 < argc && sscanf(argv[i + 1], "%d", &benchmarkFrames) == 1 && benchmarkFrames > 0) {
+            i++;
+        } else if (std::string(argv[i]) == "--benchmark-log" && i + 1 < argc) {
+            benchmarkLogPath = argv[++i];
+        } else if (std::string(argv[i]) == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (std::string(argv[i]) == "--release-host-copies") {
+            releaseHostCopies = true;
+        } else if (std::string(argv[i]) == "--storage-block-size" && i + 1 < argc && 
+                   sscanf(argv[i + 1], "%lld", &sceneOptions.storageBlockSize) == 1 && sceneOptions.storageBlockSize > 0) {
+            i++;
+        } else if (std::string(argv[i]) == "--model-memory-budget" && i + 1 < argc && 
+                   sscanf(argv[i + 1], "%lld", &sceneOptions.modelMemoryBudget) == 1 && sceneOptions.modelMemoryBudget > 0) {
+            sceneOptions.modelMemoryBudget *= 1024 * 1024;
+            i++;
+        } else if (std::string(argv[i]) == "--progressive-bvh") {
+            sceneOptions.progressiveBVH = true;
+        } else {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--profile [<log.csv|log.json>]]" 
+                      << " [--benchmark [<camera_path.txt>] [--frames <n>] [--benchmark-log <log.csv>]] [--trace <trace.json>]"
+                      << " [--release-host-copies] [--storage-block-size <bytes>]"
+                      << " [--model-memory-budget <MB>] [--progressive-bvh]" << std::endl;
+            return -1;
+        }
+    }
+
+    if (!tracePath.empty()) {
+        TraceEvents::start(tracePath);
+    }
+    TraceScope startupTrace("startup");
+
     glfwInit();
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -63,6 +143,14 @@ int main() {
 
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+    // the framebuffer can be larger than the window on high DPI screens
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    if (!fixedRenderResolution) {
+        renderWidth = framebufferWidth;
+        renderHeight = framebufferHeight;
+    }
+
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
@@ -77,8 +165,37 @@ int main() {
     // Shader debugModelsShader("../shaders/simpleVertexShader.vert", "../shaders/simpleFragmentShader.frag");
     Shader renderRayTracingTextureShader("../shaders/raytracingVertexShader.vert", "../shaders/raytracingFragmentShader.frag");
 
-    ComputeShader pathTracingComputeShader("../shaders/pathTracingShader.comp");
-    Scene testScene(pathTracingComputeShader, SCR_WIDTH, SCR_HEIGHT);
+    std::unique_ptr<GpuProfiler> profiler;
+    if (profile) {
+        profiler = std::make_unique<GpuProfiler>(profileLogPath);
+        ComputeShader::setProfiler(profiler.get());
+    }
+
+    std::unique_ptr<Benchmark> benchmark;
+    if (benchmarkRun) {
+        benchmark = std::make_unique<Benchmark>(cameraPathFile, benchmarkFrames, benchmarkLogPath);
+        if (!benchmark->isValid()) {
+            glfwTerminate();
+            return -1;
+        }
+
+        // the frames are not held back by the display
+        glfwSwapInterval(0);
+        std::cout << "Benchmark on " << glGetString(GL_RENDERER) << ", " << renderWidth << " x " << renderHeight << " pixels, " 
+                  << renderSettings.samplesPerPixel << " samples per pixel" << std::endl;
+    }
+
+    Scene testScene("../shaders/pathTracingShader.comp", renderWidth, renderHeight, sceneOptions);
+    if (!testScene.isValid()) {
+        glfwTerminate();
+        return -1;
+    }
+    if (releaseHostCopies) {
+        testScene.releaseHostCopies();
+        testScene.printMemoryReport();
+    }
+
+    startupTrace.end();
 
     // FPS variables
     double prevTime = 0.0f;
@@ -87,6 +204,16 @@ int main() {
     unsigned int counter = 0;
 
     while (!glfwWindowShouldClose(window)) {
+        if (benchmark && benchmark->isDone()) {
+            break;
+        }
+
+        double frameStart = glfwGetTime();
+        TraceScope frameTrace("frame");
+        if (profiler) {
+            profiler->beginFrame();
+        }
+
         // FPS counter
         crntTime = glfwGetTime();
         timeDiff = crntTime - prevTime;
@@ -104,7 +231,15 @@ int main() {
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
-        processInput(window);
+        // the benchmark ignores the inputs, the same settings and camera path always give the same frames
+        if (benchmark) {
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                glfwSetWindowShouldClose(window, true);
+            }
+            benchmark->setCamera(camera);
+        } else {
+            processInput(window);
+        }
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -118,27 +253,80 @@ int main() {
         // debugModelsShader.setMat4("model", model);
         // mod.draw(debugModelsShader);
 
-        GLuint thisFrameTex = testScene.renderScene(camera.Position, view, accumulateFrames, frameCounter);
-        if (accumulateFrames) {
+        bool cameraMoving = view != lastView;
+        lastView = view;
+
+        // while the camera moves, the frames shrink to keep the frame time and are not accumulated,
+        // once it stops they are accumulated at full resolution
+        bool accumulate = accumulateFrames;
+        if (dynamicResolution) {
+            renderSettings.resolutionScale = dynamicResolutionController.update(deltaTime * 1000.0f, cameraMoving);
+            accumulate = !cameraMoving;
+            if (cameraMoving) {
+                frameCounter = 0;
+            }
+        }
+
+        double renderStart = glfwGetTime();
+        TraceScope renderTrace("renderScene");
+        testScene.resize(renderWidth, renderHeight);
+        if (captureRays) {
+            testScene.captureRays(RAY_DUMP_PATH, camera.Position, view, renderSettings);
+            captureRays = false;
+        }
+        GLuint thisFrameTex = testScene.renderScene(camera.Position, view, accumulate, frameCounter, renderSettings);
+        if (accumulate) {
             frameCounter++;
         }
+        renderTrace.end();
 
-        renderRaytracingQuad(renderRayTracingTextureShader, thisFrameTex);
+        if (profiler) {
+            profiler->addCpuTime("renderScene", (glfwGetTime() - renderStart) * 1000.0);
+            profiler->begin("present");
+        }
+        TraceScope presentTrace("present");
+        renderRaytracingQuad(renderRayTracingTextureShader, thisFrameTex, testScene.getRenderScale());
+        presentTrace.end();
+        if (profiler) {
+            profiler->end();
+        }
 
         // swap buffers, do events
+        double swapStart = glfwGetTime();
+        TraceScope swapTrace("swap");
         glfwSwapBuffers(window);
+        swapTrace.end();
+        if (profiler) {
+            profiler->addCpuTime("swap", (glfwGetTime() - swapStart) * 1000.0);
+        }
+        if (benchmark) {
+            glFinish();
+            benchmark->addFrame((glfwGetTime() - frameStart) * 1000.0);
+        }
         glfwPollEvents();
     }
 
+    if (benchmark) {
+        benchmark->printSummary();
+    }
+
+    if (profiler) {
+        profiler->print();
+        ComputeShader::setProfiler(nullptr);
+        profiler.reset();
+    }
+
+    TraceEvents::stop();
+
     // glDeleteProgram(debugModelsShader.ID);
-    glDeleteProgram(pathTracingComputeShader.ID);
+    ComputeShader::deleteCachedPrograms();
     glDeleteProgram(renderRayTracingTextureShader.ID);
 
     glfwTerminate();
     return 0;
 }
 
-void renderRaytracingQuad(Shader shader, GLuint screenTex) {
+void renderRaytracingQuad(Shader shader, GLuint screenTex, glm::vec2 uvScale) {
      static unsigned int quadVAO = 0, quadVBO = 0, quadEBO = 0;
     if (quadVAO == 0) {
         float quadVertices[] = {
@@ -168,6 +356,7 @@ void renderRaytracingQuad(Shader shader, GLuint screenTex) {
 
     shader.use();
     shader.setInt("screenTexture", 0);
+    shader.setVec2("uvScale", uvScale);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, screenTex);
@@ -205,6 +394,143 @@ void processInput(GLFWwindow* window) {
     } else {
         fKeyPressed = false;
     }
+
+    static bool mKeyPressed = false;
+
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+        if (!mKeyPressed) {
+            frameCounter = 0;
+
+            const char* backendNames[] = { "megakernel", "wavefront", "CPU" };
+            renderSettings.backend = (Render_Backend)((renderSettings.backend + 1) % 3);
+            mKeyPressed = true;
+            std::cout << "Render backend is " << backendNames[renderSettings.backend] << std::endl;
+        }
+    } else {
+        mKeyPressed = false;
+    }
+
+    static bool rKeyPressed = false;
+
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
+        if (!rKeyPressed) {
+            renderSettings.sortRays = !renderSettings.sortRays;
+            rKeyPressed = true;
+            std::cout << "Ray sorting is " << (renderSettings.sortRays ? "ON" : "OFF") << std::endl;
+        }
+    } else {
+        rKeyPressed = false;
+    }
+
+    static bool vKeyPressed = false;
+
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
+        if (!vKeyPressed) {
+            // the pixel statistics restart with the accumulation
+            frameCounter = 0;
+
+            renderSettings.adaptiveSampling = !renderSettings.adaptiveSampling;
+            vKeyPressed = true;
+            std::cout << "Adaptive sampling is " << (renderSettings.adaptiveSampling ? "ON" : "OFF") << std::endl;
+        }
+    } else {
+        vKeyPressed = false;
+    }
+
+    static bool tKeyPressed = false;
+
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
+        if (!tKeyPressed) {
+            renderSettings.temporalReprojection = !renderSettings.temporalReprojection;
+            tKeyPressed = true;
+            std::cout << "Temporal reprojection is " << (renderSettings.temporalReprojection ? "ON" : "OFF") << std::endl;
+        }
+    } else {
+        tKeyPressed = false;
+    }
+
+    static bool nKeyPressed = false;
+
+    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
+        if (!nKeyPressed) {
+            renderSettings.denoise = !renderSettings.denoise;
+            nKeyPressed = true;
+            std::cout << "Denoiser is " << (renderSettings.denoise ? "ON" : "OFF") << std::endl;
+        }
+    } else {
+        nKeyPressed = false;
+    }
+
+    static bool gKeyPressed = false;
+
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+        if (!gKeyPressed) {
+            frameCounter = 0;
+
+            dynamicResolution = !dynamicResolution;
+            renderSettings.resolutionScale = 1.0f;
+            gKeyPressed = true;
+            std::cout << "Dynamic resolution is " << (dynamicResolution ? "ON" : "OFF") << std::endl;
+        }
+    } else {
+        gKeyPressed = false;
+    }
+
+    static bool hKeyPressed = false;
+
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) {
+        if (!hKeyPressed) {
+            // off -> nodes visited -> AABB tests -> triangle tests -> off
+            const char* metricNames[] = { "nodes visited", "AABB tests", "triangle tests" };
+            if (!renderSettings.traversalHeatmap) {
+                renderSettings.traversalHeatmap = true;
+                renderSettings.traversalMetric = NODES_VISITED;
+            } else if (renderSettings.traversalMetric == TRIANGLE_TESTS) {
+                renderSettings.traversalHeatmap = false;
+            } else {
+                renderSettings.traversalMetric = (Traversal_Metric)(renderSettings.traversalMetric + 1);
+            }
+            hKeyPressed = true;
+
+            if (renderSettings.traversalHeatmap) {
+                std::cout << "Traversal heatmap shows the " << metricNames[renderSettings.traversalMetric] 
+                          << (renderSettings.backend == WAVEFRONT ? " (megakernel and CPU backends only)" : "") << std::endl;
+            } else {
+                std::cout << "Traversal heatmap is OFF" << std::endl;
+            }
+        }
+    } else {
+        hKeyPressed = false;
+    }
+
+    static bool cKeyPressed = false;
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+        if (!cKeyPressed) {
+            captureRays = true;
+            cKeyPressed = true;
+        }
+    } else {
+        cKeyPressed = false;
+    }
+
+    static bool bracketKeyPressed = false;
+
+    bool lessSamples = glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS;
+    bool moreSamples = glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS;
+    if (lessSamples || moreSamples) {
+        if (!bracketKeyPressed) {
+            // the sample sequences of the pixels are indexed by frameCounter * samplesPerPixel
+            frameCounter = 0;
+
+            int samples = moreSamples ? renderSettings.samplesPerPixel * 2 : renderSettings.samplesPerPixel / 2;
+            renderSettings.samplesPerPixel = glm::clamp(samples, 1, MAX_SAMPLES_PER_PIXEL);
+            bracketKeyPressed = true;
+            std::cout << "Samples per pixel: " << renderSettings.samplesPerPixel << std::endl;
+        }
+    } else {
+        bracketKeyPressed = false;
+    }
 }
 
 void mouseCallback(GLFWwindow* window, double xposIn, double yposIn) {
@@ -228,4 +554,12 @@ void mouseCallback(GLFWwindow* window, double xposIn, double yposIn) {
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+
+    // a minimized window has no pixels, the frames keep their size
+    if (!fixedRenderResolution && width > 0 && height > 0 && 
+        (width != (int)renderWidth || height != (int)renderHeight)) {
+        renderWidth = width;
+        renderHeight = height;
+        frameCounter = 0;
+    }
 }
\ No newline at end of file
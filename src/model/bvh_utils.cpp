@@ -1,5 +1,26 @@
 #include "bvh_utils.h"
 
+#include <algorithm>
+#include <limits>
+
+const int SAH_BINS = 12;
+
+// Spreads the 21 bits of v to every third bit
+static uint64_t spreadBits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+uint64_t mortonCode(glm::vec3 point) {
+    glm::vec3 cell = glm::clamp(point * 2097152.0f, glm::vec3(0.0f), glm::vec3(2097151.0f));
+    return spreadBits((uint64_t)cell.x) << 2 | spreadBits((uint64_t)cell.y) << 1 | spreadBits((uint64_t)cell.z);
+}
+
 std::unique_ptr<BVHTree> BVHUtils::subdivideModel(glm::vec3 minPoint, glm::vec3 maxPoint,
                                    std::vector<std::array<int,3>>& modelFaces,
                                    std::vector<glm::vec3>& centroids,
@@ -84,6 +105,10 @@ std::unique_ptr<BVHTree> BVHUtils::subdivideModel(glm::vec3 minPoint, glm::vec3
         bvh->rightChild = subdivideModel(minRight, maxRight, modelFacesRight, centroidsRight, modelVertices, indices, numberOfFacesInLeaves);
     }
 
+    // freed before the left subtree is built, so only one side of every level is alive at a time
+    std::vector<std::array<int,3>>().swap(modelFacesRight);
+    std::vector<glm::vec3>().swap(centroidsRight);
+
     if (!modelFacesLeft.empty()) {
         bvh->leftChild = subdivideModel(minLeft, maxLeft, modelFacesLeft, centroidsLeft, modelVertices, indices, numberOfFacesInLeaves);
     }
@@ -121,3 +146,209 @@ int BVHUtils::numberOfChildrenInBVHTree(BVHTree& bvh) {
 
     return sum;
 }
+
+// The faces of buildLBVH and subdivideModelSAH, which reorder faceOrder instead of copying the faces
+struct BVHBuildInput {
+    const std::vector<std::array<int,3>>& faces;
+    const std::vector<glm::vec3>& centroids;
+    const std::vector<glm::vec3>& vertices;
+    std::vector<glm::ivec4>& indices;
+    int numberOfFacesInLeaves;
+    std::vector<int> faceOrder;
+};
+
+static void growBounds(const BVHBuildInput& input, int face, glm::vec3& minPoint, glm::vec3& maxPoint) {
+    for (int j = 0; j < 3; j++) {
+        glm::vec3 pos = input.vertices[input.faces[face][j]];
+        minPoint = glm::min(minPoint, pos);
+        maxPoint = glm::max(maxPoint, pos);
+    }
+}
+
+static std::unique_ptr<BVHTree> createLeaf(BVHBuildInput& input, int first, int last) {
+    glm::vec3 minPoint(std::numeric_limits<float>::max());
+    glm::vec3 maxPoint(-std::numeric_limits<float>::max());
+    int firstFaceIndex = input.indices.size();
+    for (int i = first; i < last; i++) {
+        const std::array<int,3>& f = input.faces[input.faceOrder[i]];
+        growBounds(input, input.faceOrder[i], minPoint, maxPoint);
+        input.indices.push_back(glm::ivec4(f[0], f[1], f[2], 0));
+    }
+
+    return std::make_unique<BVHTree>(BVHNode(minPoint, maxPoint, true, -1, firstFaceIndex, input.indices.size() - 1));
+}
+
+static std::unique_ptr<BVHTree> createInnerNode(std::unique_ptr<BVHTree> leftChild, std::unique_ptr<BVHTree> rightChild) {
+    glm::vec3 minPoint = glm::min(leftChild->bvhNode.minVertPos, rightChild->bvhNode.minVertPos);
+    glm::vec3 maxPoint = glm::max(leftChild->bvhNode.maxVertPos, rightChild->bvhNode.maxVertPos);
+    std::unique_ptr<BVHTree> bvh = std::make_unique<BVHTree>(BVHNode(minPoint, maxPoint, false, -1, 0, 0));
+    bvh->leftChild = std::move(leftChild);
+    bvh->rightChild = std::move(rightChild);
+    return bvh;
+}
+
+// codes are the Morton codes in the order of faceOrder
+static std::unique_ptr<BVHTree> buildLBVHRange(BVHBuildInput& input, const std::vector<uint64_t>& codes, int first, int last) {
+    if (last - first <= input.numberOfFacesInLeaves) {
+        return createLeaf(input, first, last);
+    }
+
+    // the codes of the range share the bits above the highest differing bit, the ones with that bit set come last
+    int split = (first + last) / 2;
+    uint64_t differentBits = codes[first] ^ codes[last - 1];
+    if (differentBits != 0) {
+        uint64_t highestBit = 1ull << 63;
+        while (!(differentBits & highestBit)) {
+            highestBit >>= 1;
+        }
+        split = std::partition_point(codes.begin() + first, codes.begin() + last, [&](uint64_t code) {
+            return !(code & highestBit);
+        }) - codes.begin();
+    }
+
+    std::unique_ptr<BVHTree> leftChild = buildLBVHRange(input, codes, first, split);
+    std::unique_ptr<BVHTree> rightChild = buildLBVHRange(input, codes, split, last);
+    return createInnerNode(std::move(leftChild), std::move(rightChild));
+}
+
+std::unique_ptr<BVHTree> BVHUtils::buildLBVH(const std::vector<std::array<int,3>>& modelFaces,
+                                   const std::vector<glm::vec3>& centroids,
+                                   const std::vector<glm::vec3>& modelVertices,
+                                   std::vector<glm::ivec4>& indices, 
+                                   int numberOfFacesInLeaves) {
+
+    BVHBuildInput input = { modelFaces, centroids, modelVertices, indices, std::max(numberOfFacesInLeaves, 1), {} };
+    if (modelFaces.empty()) {
+        glm::vec3 minPoint = modelVertices.empty() ? glm::vec3(0) : modelVertices[0];
+        return std::make_unique<BVHTree>(BVHNode(minPoint, minPoint, true, -1, indices.size(), indices.size() - 1));
+    }
+
+    glm::vec3 minCentroid = centroids[0];
+    glm::vec3 maxCentroid = centroids[0];
+    for (const glm::vec3& centroid : centroids) {
+        minCentroid = glm::min(minCentroid, centroid);
+        maxCentroid = glm::max(maxCentroid, centroid);
+    }
+    glm::vec3 extent = glm::max(maxCentroid - minCentroid, glm::vec3(1e-20f));
+
+    std::vector<std::pair<uint64_t, int>> sortedFaces(modelFaces.size());
+    for (int i = 0; i < modelFaces.size(); i++) {
+        sortedFaces[i] = { mortonCode((centroids[i] - minCentroid) / extent), i };
+    }
+    std::sort(sortedFaces.begin(), sortedFaces.end());
+
+    std::vector<uint64_t> codes(sortedFaces.size());
+    input.faceOrder.resize(sortedFaces.size());
+    for (int i = 0; i < sortedFaces.size(); i++) {
+        codes[i] = sortedFaces[i].first;
+        input.faceOrder[i] = sortedFaces[i].second;
+    }
+    std::vector<std::pair<uint64_t, int>>().swap(sortedFaces);
+
+    return buildLBVHRange(input, codes, 0, modelFaces.size());
+}
+
+static float halfArea(glm::vec3 minPoint, glm::vec3 maxPoint) {
+    glm::vec3 size = glm::max(maxPoint - minPoint, glm::vec3(0));
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static std::unique_ptr<BVHTree> subdivideSAHRange(BVHBuildInput& input, int first, int last, const std::atomic<bool>* cancel) {
+    if (cancel && cancel->load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    if (last - first <= input.numberOfFacesInLeaves) {
+        return createLeaf(input, first, last);
+    }
+
+    glm::vec3 minCentroid = input.centroids[input.faceOrder[first]];
+    glm::vec3 maxCentroid = minCentroid;
+    for (int i = first; i < last; i++) {
+        minCentroid = glm::min(minCentroid, input.centroids[input.faceOrder[i]]);
+        maxCentroid = glm::max(maxCentroid, input.centroids[input.faceOrder[i]]);
+    }
+
+    struct Bin {
+        int count = 0;
+        glm::vec3 minPoint = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 maxPoint = glm::vec3(-std::numeric_limits<float>::max());
+    };
+
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    int bestBin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = maxCentroid[axis] - minCentroid[axis];
+        if (extent <= 0) {
+            continue;
+        }
+
+        Bin bins[SAH_BINS];
+        for (int i = first; i < last; i++) {
+            int face = input.faceOrder[i];
+            int bin = glm::min((int)((input.centroids[face][axis] - minCentroid[axis]) / extent * SAH_BINS), SAH_BINS - 1);
+            bins[bin].count++;
+            growBounds(input, face, bins[bin].minPoint, bins[bin].maxPoint);
+        }
+
+        // the cost of the faces right of every split, swept from the right
+        float rightCosts[SAH_BINS];
+        Bin right;
+        for (int bin = SAH_BINS - 1; bin > 0; bin--) {
+            right.count += bins[bin].count;
+            right.minPoint = glm::min(right.minPoint, bins[bin].minPoint);
+            right.maxPoint = glm::max(right.maxPoint, bins[bin].maxPoint);
+            rightCosts[bin] = right.count * halfArea(right.minPoint, right.maxPoint);
+        }
+
+        Bin left;
+        for (int bin = 1; bin < SAH_BINS; bin++) {
+            left.count += bins[bin - 1].count;
+            left.minPoint = glm::min(left.minPoint, bins[bin - 1].minPoint);
+            left.maxPoint = glm::max(left.maxPoint, bins[bin - 1].maxPoint);
+
+            float cost = left.count * halfArea(left.minPoint, left.maxPoint) + rightCosts[bin];
+            if (left.count > 0 && left.count < last - first && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    // the faces that cannot be told apart by their centroids are split in half, so the leaves stay small
+    int split = (first + last) / 2;
+    if (bestAxis >= 0) {
+        float extent = maxCentroid[bestAxis] - minCentroid[bestAxis];
+        split = std::partition(input.faceOrder.begin() + first, input.faceOrder.begin() + last, [&](int face) {
+            return glm::min((int)((input.centroids[face][bestAxis] - minCentroid[bestAxis]) / extent * SAH_BINS), SAH_BINS - 1) < bestBin;
+        }) - input.faceOrder.begin();
+    }
+
+    std::unique_ptr<BVHTree> leftChild = subdivideSAHRange(input, first, split, cancel);
+    std::unique_ptr<BVHTree> rightChild = leftChild ? subdivideSAHRange(input, split, last, cancel) : nullptr;
+    if (!leftChild || !rightChild) {
+        return nullptr;
+    }
+    return createInnerNode(std::move(leftChild), std::move(rightChild));
+}
+
+std::unique_ptr<BVHTree> BVHUtils::subdivideModelSAH(const std::vector<std::array<int,3>>& modelFaces,
+                                   const std::vector<glm::vec3>& centroids,
+                                   const std::vector<glm::vec3>& modelVertices,
+                                   std::vector<glm::ivec4>& indices, 
+                                   int numberOfFacesInLeaves,
+                                   const std::atomic<bool>* cancel) {
+
+    BVHBuildInput input = { modelFaces, centroids, modelVertices, indices, std::max(numberOfFacesInLeaves, 1), {} };
+    if (modelFaces.empty()) {
+        glm::vec3 minPoint = modelVertices.empty() ? glm::vec3(0) : modelVertices[0];
+        return std::make_unique<BVHTree>(BVHNode(minPoint, minPoint, true, -1, indices.size(), indices.size() - 1));
+    }
+
+    input.faceOrder.resize(modelFaces.size());
+    for (int i = 0; i < modelFaces.size(); i++) {
+        input.faceOrder[i] = i;
+    }
+    return subdivideSAHRange(input, 0, modelFaces.size(), cancel);
+}
@@ -3,6 +3,8 @@
 
 #include <memory>
 #include <array>
+#include <atomic>
+#include <cstdint>
 
 #include <glm/glm.hpp>
 
@@ -35,6 +37,9 @@ struct BVHTree {
     }
 };
 
+// Morton code of a point of the unit cube, 21 bits per axis
+uint64_t mortonCode(glm::vec3 point);
+
 class BVHUtils {
 public:
     std::unique_ptr<BVHTree> subdivideModel(glm::vec3 minPoint, glm::vec3 maxPoint,
@@ -44,6 +49,22 @@ public:
                            std::vector<glm::ivec4>& indices, 
                            int numberOfFacesInLeaves);
 
+    // Linear BVH: the faces are sorted by the Morton code of their centroid and split where the highest
+    // differing bit of the codes changes. Much faster to build than subdivideModel, with looser boxes
+    std::unique_ptr<BVHTree> buildLBVH(const std::vector<std::array<int,3>>& modelFaces,
+                           const std::vector<glm::vec3>& centroids,
+                           const std::vector<glm::vec3>& modelVertices,
+                           std::vector<glm::ivec4>& indices, 
+                           int numberOfFacesInLeaves);
+
+    // Splits where the surface area heuristic is the lowest, over 12 bins per axis. Returns nullptr once cancel is set
+    std::unique_ptr<BVHTree> subdivideModelSAH(const std::vector<std::array<int,3>>& modelFaces,
+                           const std::vector<glm::vec3>& centroids,
+                           const std::vector<glm::vec3>& modelVertices,
+                           std::vector<glm::ivec4>& indices, 
+                           int numberOfFacesInLeaves,
+                           const std::atomic<bool>* cancel = nullptr);
+
     void addBVHTreeToBVHNodes(BVHTree& bvh, int missIndex, bool isRight, std::vector<BVHNode>& bvhNodes);
 
 private:
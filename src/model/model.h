@@ -63,6 +63,50 @@ struct alignas(16) Material {
     }
 };
 
+struct alignas(16) Sphere {
+    glm::vec3 center;
+    float radius;
+    Material material;
+                            
+    Sphere(glm::vec3 center, float radius, Material material) : 
+        center(center), radius(radius), material(material) {
+
+    }
+};
+
+enum Light_Type {
+    LIGHT_TRIANGLE,
+    LIGHT_SPHERE
+};
+
+// An emissive triangle (v0, v1, v2) or sphere (center v0, radius v1.x), 
+// cdf is the running sum of the light areas divided by their total
+struct alignas(16) Light {
+    glm::vec3 v0;
+    int type;
+    glm::vec3 v1;
+    float cdf;
+    glm::vec3 v2;
+    float area;
+    glm::vec3 emission;
+    float pad;
+
+    Light(int type, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, float area, glm::vec3 emission) :
+        v0(v0), type(type), v1(v1), cdf(0), v2(v2), area(area), emission(emission), pad(0) {
+
+    }
+};
+
+// Closest hit of a traversal: primitiveIndex is the face index for models and the sphere index 
+// for spheres (modelIndex -1), -1 on a miss. barycentrics are the weights of the 2nd and 3rd vertex.
+struct alignas(8) HitRecord {
+    glm::vec2 barycentrics;
+    float dist;
+    int primitiveIndex;
+    int modelIndex;
+    int vertexOffset;
+};
+
 struct ModelInfo {
     int vertexCount;
     int indexCount;
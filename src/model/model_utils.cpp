@@ -32,6 +32,7 @@ void ModelUtils::printModelData(Model model) {
 }
 
 Model ModelUtils::createModelFromPLY(const char* modelFilePath, bool containsNormals) {
+    TraceScope trace("createModelFromPLY");
     Model model;
     std::ifstream modelFile(modelFilePath);
 
@@ -42,8 +43,10 @@ Model ModelUtils::createModelFromPLY(const char* modelFilePath, bool containsNor
 
     std::string line;
     bool headerEnded = false;
+    size_t bytesRead = 0;
 
     while (getline(modelFile, line)) {
+        bytesRead += line.size() + 1;
         if (!headerEnded) {
             if (line == "end_header") {
                 headerEnded = true;
@@ -82,6 +85,7 @@ Model ModelUtils::createModelFromPLY(const char* modelFilePath, bool containsNor
     }
 
     modelFile.close();
+    trace.setBytes(bytesRead);
     return model;
 }
 
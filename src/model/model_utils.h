@@ -8,6 +8,7 @@
 #include <glm/glm.hpp>
 
 #include "model.h"
+#include "../trace_events.h"
 
 class ModelUtils {
 public:
@@ -0,0 +1,530 @@
+#include "out_of_core_bvh.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <sstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../trace_events.h"
+
+// bytes written or read at a time by the passes that stream a file
+const size_t STREAM_CHUNK_SIZE = 1 << 20;
+// vertices per block of the position cache
+const size_t POSITION_BLOCK_VERTICES = 1 << 14;
+// bytes of a face of a segment while it is subdivided: the sorted face, its 3 vertices, its face and centroid
+// and their copies in the levels below
+const size_t SEGMENT_BYTES_PER_FACE = 256;
+const size_t MIN_SEGMENT_FACES = 256;
+// subdivideModel passes the vertex indices of the segment through floats, which are exact up to 2^24
+const size_t MAX_SEGMENT_FACES = 1 << 22;
+const size_t MIN_RUN_FACES = 1024;
+const size_t MIN_READER_FACES = 64;
+
+template<typename T>
+static void writeElements(std::ofstream& file, const std::vector<T>& elements) {
+    file.write((const char*)elements.data(), sizeof(T) * elements.size());
+}
+
+// Reads up to count elements, fewer at the end of the file
+template<typename T>
+static size_t readElements(std::ifstream& file, std::vector<T>& elements, size_t count) {
+    elements.resize(count);
+    file.read((char*)elements.data(), sizeof(T) * count);
+    elements.resize(file.gcount() / sizeof(T));
+    return elements.size();
+}
+
+static void copyFile(std::ifstream& from, std::ofstream& to) {
+    std::vector<char> chunk(STREAM_CHUNK_SIZE);
+    while (readElements(from, chunk, STREAM_CHUNK_SIZE) > 0) {
+        writeElements(to, chunk);
+    }
+}
+
+static void removeRuns(const std::string& tempPath, int runCount) {
+    std::error_code error;
+    for (int run = 0; run < runCount; run++) {
+        std::filesystem::remove(tempPath + ".run" + std::to_string(run), error);
+    }
+}
+
+static bool mortonLess(const MortonFace& a, const MortonFace& b) {
+    return a.code < b.code || (a.code == b.code && a.face < b.face);
+}
+
+// Positions of the vertex file in blocks, a block maps to a fixed slot. When every block fits, the file is read once
+class PositionCache {
+public:
+    PositionCache(const std::string& path, long long vertexCount, size_t bytes) : file(path, std::ios::binary), vertexCount(vertexCount) {
+        long long blockCount = (vertexCount + POSITION_BLOCK_VERTICES - 1) / POSITION_BLOCK_VERTICES;
+        slots = std::max<size_t>(bytes / (sizeof(glm::vec3) * POSITION_BLOCK_VERTICES), 1);
+        slots = std::min<size_t>(slots, std::max<long long>(blockCount, 1));
+        slotBlocks.assign(slots, -1);
+        positions.resize(slots * POSITION_BLOCK_VERTICES);
+    }
+
+    glm::vec3 get(long long vertex) {
+        long long block = vertex / POSITION_BLOCK_VERTICES;
+        size_t slot = block % slots;
+        if (slotBlocks[slot] != block) {
+            load(block, slot);
+        }
+        return positions[slot * POSITION_BLOCK_VERTICES + vertex % POSITION_BLOCK_VERTICES];
+    }
+
+private:
+    std::ifstream file;
+    long long vertexCount;
+    size_t slots;
+    std::vector<long long> slotBlocks;
+    std::vector<glm::vec3> positions;
+    std::vector<Vertex> blockVertices;
+
+    void load(long long block, size_t slot) {
+        long long first = block * POSITION_BLOCK_VERTICES;
+        file.clear();
+        file.seekg(sizeof(Vertex) * first);
+        readElements(file, blockVertices, std::min<long long>(POSITION_BLOCK_VERTICES, vertexCount - first));
+        for (size_t i = 0; i < blockVertices.size(); i++) {
+            const Vertex& vertex = blockVertices[i];
+            positions[slot * POSITION_BLOCK_VERTICES + i] = glm::vec3(vertex.x, vertex.y, vertex.z);
+        }
+        slotBlocks[slot] = block;
+    }
+};
+
+// A sorted run, read a buffer at a time while the runs are merged
+class RunReader {
+public:
+    RunReader(const std::string& path, size_t capacity) : file(path, std::ios::binary), capacity(capacity) {
+        readElements(file, buffer, capacity);
+    }
+
+    bool isDone() const { return position >= buffer.size(); }
+    const MortonFace& current() const { return buffer[position]; }
+
+    void advance() {
+        if (++position == buffer.size()) {
+            readElements(file, buffer, capacity);
+            position = 0;
+        }
+    }
+
+private:
+    std::ifstream file;
+    size_t capacity;
+    std::vector<MortonFace> buffer;
+    size_t position = 0;
+};
+
+OutOfCoreBVHBuilder::OutOfCoreBVHBuilder(size_t memoryBudget) : memoryBudget(memoryBudget) {
+
+}
+
+// FNV-1a
+static unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+unsigned long long OutOfCoreBVHBuilder::modelCacheKey(const char* modelFilePath, glm::vec3 offset, float scale, float angle, int maximumNumberOfFacesPerNode) {
+    std::error_code error;
+    unsigned long long fileSize = std::filesystem::file_size(modelFilePath, error);
+    long long fileTime = std::filesystem::last_write_time(modelFilePath, error).time_since_epoch().count();
+
+    unsigned long long key = 14695981039346656037ull;
+    key = hashBytes(key, modelFilePath, std::strlen(modelFilePath));
+    key = hashBytes(key, &fileSize, sizeof(fileSize));
+    key = hashBytes(key, &fileTime, sizeof(fileTime));
+    key = hashBytes(key, &offset[0], sizeof(float) * 3);
+    key = hashBytes(key, &scale, sizeof(scale));
+    key = hashBytes(key, &angle, sizeof(angle));
+    key = hashBytes(key, &maximumNumberOfFacesPerNode, sizeof(maximumNumberOfFacesPerNode));
+    key = hashBytes(key, &MODEL_CACHE_VERSION, sizeof(MODEL_CACHE_VERSION));
+    return key;
+}
+
+std::string OutOfCoreBVHBuilder::modelCachePath(unsigned long long key) {
+    std::stringstream fileName;
+    fileName << std::hex << key << ".bvh";
+    return (std::filesystem::path(SCENE_CACHE_DIRECTORY) / fileName.str()).string();
+}
+
+bool OutOfCoreBVHBuilder::build(const char* modelFilePath, glm::vec3 offset, float scale, float angle, int maximumNumberOfFacesPerNode, unsigned long long key) {
+    TraceScope trace("out-of-core BVH build");
+    std::error_code error;
+    std::filesystem::create_directories(SCENE_CACHE_DIRECTORY, error);
+
+    std::string cachePath = modelCachePath(key);
+    std::string tempPath = cachePath + ".tmp";
+    segments.clear();
+
+    long long vertexCount = 0;
+    long long faceCount = 0;
+    glm::vec3 minPoint, maxPoint;
+    int runCount = -1;
+    bool success = parseModel(modelFilePath, offset, scale, angle, tempPath, vertexCount, faceCount, minPoint, maxPoint);
+    if (success) {
+        runCount = writeSortedRuns(tempPath, vertexCount, faceCount, minPoint, maxPoint);
+        success = runCount >= 0 && buildSegments(tempPath, runCount, maximumNumberOfFacesPerNode);
+    }
+
+    long long nodeCount = 0;
+    if (success) {
+        TraceScope writeTrace("write model cache");
+        std::ofstream file(tempPath, std::ios::binary);
+
+        ModelCacheHeader header = {};
+        std::memcpy(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic));
+        header.version = MODEL_CACHE_VERSION;
+        header.key = key;
+        header.vertexCount = vertexCount;
+        header.faceCount = faceCount;
+        file.write((const char*)&header, sizeof(header));
+
+        std::ifstream vertexFile(tempPath + ".vertices", std::ios::binary);
+        copyFile(vertexFile, file);
+        std::ifstream indexFile(tempPath + ".indices", std::ios::binary);
+        copyFile(indexFile, file);
+
+        // the leaf of a model without faces is empty, like the one of subdivideModel
+        if (segments.empty()) {
+            BVHNode leaf(minPoint, maxPoint, true, -1, 0, -1);
+            file.write((const char*)&leaf, sizeof(leaf));
+            nodeCount = 1;
+        } else {
+            std::ifstream segmentNodes(tempPath + ".nodes", std::ios::binary);
+            long long faceOffset = 0;
+            writeTopLevels(0, segments.size(), -1, nodeCount, faceOffset, segmentNodes, file);
+        }
+
+        header.nodeCount = nodeCount;
+        file.seekp(0);
+        file.write((const char*)&header, sizeof(header));
+        writeTrace.setBytes(file.tellp());
+        success = file.good();
+        if (!success) {
+            std::cout << "Could not write the model cache file " << tempPath << std::endl;
+        }
+    }
+
+    std::filesystem::remove(tempPath + ".vertices", error);
+    std::filesystem::remove(tempPath + ".faces", error);
+    std::filesystem::remove(tempPath + ".indices", error);
+    std::filesystem::remove(tempPath + ".nodes", error);
+    removeRuns(tempPath, runCount);
+
+    if (!success) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    // written next to the final file first, so an interrupted build never leaves a truncated model behind
+    std::filesystem::rename(tempPath, cachePath, error);
+    std::cout << "Out-of-core BVH of " << modelFilePath << ": " << vertexCount << " vertices, " << faceCount << " faces, "
+              << runCount << " sorted runs, " << segments.size() << " segments, " << nodeCount << " BVH nodes" << std::endl;
+    return !error;
+}
+
+// Streams the transformed vertices and the faces of the PLY file to their own files
+bool OutOfCoreBVHBuilder::parseModel(const char* modelFilePath, glm::vec3 offset, float scale, float angle, const std::string& tempPath,
+                                     long long& vertexCount, long long& faceCount, glm::vec3& minPoint, glm::vec3& maxPoint) {
+    TraceScope trace("out-of-core parse");
+    std::ifstream modelFile(modelFilePath);
+    if (!modelFile.is_open()) {
+        std::cerr << "Unable to open file: " << modelFilePath << std::endl;
+        return false;
+    }
+
+    std::ofstream vertexFile(tempPath + ".vertices", std::ios::binary);
+    std::ofstream faceFile(tempPath + ".faces", std::ios::binary);
+    std::vector<Vertex> vertexChunk;
+    std::vector<std::array<int,3>> faceChunk;
+
+    glm::mat4 rotationMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+    minPoint = glm::vec3(1000000);
+    maxPoint = glm::vec3(-1000000);
+
+    std::string line;
+    bool headerEnded = false;
+    size_t bytesRead = 0;
+
+    while (getline(modelFile, line)) {
+        bytesRead += line.size() + 1;
+        if (!headerEnded) {
+            if (line == "end_header") {
+                headerEnded = true;
+            }
+            continue;
+        }
+
+        double values[6];
+        int valueCount = 0;
+        const char* text = line.c_str();
+        while (valueCount < 6) {
+            char* end;
+            double value = std::strtod(text, &end);
+            if (end == text) {
+                break;
+            }
+            values[valueCount++] = value;
+            text = end;
+        }
+
+        if (valueCount == 0) {
+            continue;
+        }
+
+        // the same rule and transform as createModelFromPLY and Scene::addModel
+        if (values[0] != 3) {
+            glm::vec3 pos((float)values[0], valueCount > 1 ? (float)values[1] : 0.0f, valueCount > 2 ? (float)values[2] : 0.0f);
+            glm::vec3 normal(0.0f);
+            if (valueCount >= 6) {
+                normal = glm::vec3((float)values[3], (float)values[4], (float)values[5]);
+            }
+
+            pos = glm::vec3(rotationMatrix * glm::vec4(pos, 1.0f));
+            pos = (pos + offset) * scale;
+            normal = glm::vec3(rotationMatrix * glm::vec4(normal, 0.0f));
+            minPoint = glm::min(minPoint, pos);
+            maxPoint = glm::max(maxPoint, pos);
+
+            Vertex vertex(pos, normal);
+            vertex.pad1 = vertex.pad2 = 0;
+            vertexChunk.push_back(vertex);
+            if (vertexChunk.size() * sizeof(Vertex) >= STREAM_CHUNK_SIZE) {
+                writeElements(vertexFile, vertexChunk);
+                vertexCount += vertexChunk.size();
+                vertexChunk.clear();
+            }
+        } else if (valueCount >= 4) {
+            faceChunk.push_back({ (int)values[1], (int)values[2], (int)values[3] });
+            if (faceChunk.size() * sizeof(std::array<int,3>) >= STREAM_CHUNK_SIZE) {
+                writeElements(faceFile, faceChunk);
+                faceCount += faceChunk.size();
+                faceChunk.clear();
+            }
+        }
+    }
+
+    writeElements(vertexFile, vertexChunk);
+    vertexCount += vertexChunk.size();
+    writeElements(faceFile, faceChunk);
+    faceCount += faceChunk.size();
+
+    trace.setBytes(bytesRead);
+    if (!vertexFile.good() || !faceFile.good()) {
+        std::cout << "Could not write the temporary files of " << tempPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Sorts the faces by the Morton code of their centroid, in runs of half the budget. Returns the number of runs, -1 on an error
+int OutOfCoreBVHBuilder::writeSortedRuns(const std::string& tempPath, long long vertexCount, long long faceCount, glm::vec3 minPoint, glm::vec3 maxPoint) {
+    TraceScope trace("out-of-core sorted runs", sizeof(MortonFace) * faceCount);
+
+    // the faces look their vertices up in a quarter of the budget
+    PositionCache positions(tempPath + ".vertices", vertexCount, memoryBudget / 4);
+    std::ifstream faceFile(tempPath + ".faces", std::ios::binary);
+    std::vector<std::array<int,3>> faceChunk;
+
+    size_t runFaces = std::max(memoryBudget / 2 / sizeof(MortonFace), MIN_RUN_FACES);
+    std::vector<MortonFace> run;
+    run.reserve((size_t)std::min<long long>(runFaces, faceCount));
+    int runCount = 0;
+
+    auto writeRun = [&]() {
+        std::sort(run.begin(), run.end(), mortonLess);
+        std::ofstream runFile(tempPath + ".run" + std::to_string(runCount++), std::ios::binary);
+        writeElements(runFile, run);
+        run.clear();
+        return runFile.good();
+    };
+
+    glm::vec3 extent = glm::max(maxPoint - minPoint, glm::vec3(1e-20f));
+    long long face = 0;
+    while (readElements(faceFile, faceChunk, STREAM_CHUNK_SIZE / sizeof(std::array<int,3>)) > 0) {
+        for (const std::array<int,3>& indices : faceChunk) {
+            MortonFace mortonFace;
+            mortonFace.face = (int)face++;
+            for (int j = 0; j < 3; j++) {
+                if (indices[j] < 0 || indices[j] >= vertexCount) {
+                    std::cout << "ERROR: face " << mortonFace.face << " refers to the vertex " << indices[j] << " of " << vertexCount << std::endl;
+                    removeRuns(tempPath, runCount);
+                    return -1;
+                }
+                mortonFace.indices[j] = indices[j];
+                mortonFace.positions[j] = positions.get(indices[j]);
+            }
+
+            glm::vec3 centroid = (mortonFace.positions[0] + mortonFace.positions[1] + mortonFace.positions[2]) * 0.3333f;
+            mortonFace.code = mortonCode((centroid - minPoint) / extent);
+            run.push_back(mortonFace);
+
+            if (run.size() == runFaces && !writeRun()) {
+                removeRuns(tempPath, runCount);
+                return -1;
+            }
+        }
+    }
+
+    if (!run.empty() && !writeRun()) {
+        removeRuns(tempPath, runCount);
+        return -1;
+    }
+    return runCount;
+}
+
+// Merges the runs and subdivides every segment of consecutive faces, the faces are written in the order of the
+// leaves and the nodes of every segment with indices relative to the segment
+bool OutOfCoreBVHBuilder::buildSegments(const std::string& tempPath, int runCount, int maximumNumberOfFacesPerNode) {
+    TraceScope trace("out-of-core segments");
+    if (runCount == 0) {
+        return true;
+    }
+
+    // every run is read through its share of a quarter of the budget
+    size_t readerFaces = std::max(memoryBudget / 4 / sizeof(MortonFace) / runCount, MIN_READER_FACES);
+    std::vector<std::unique_ptr<RunReader>> readers;
+    for (int run = 0; run < runCount; run++) {
+        readers.push_back(std::make_unique<RunReader>(tempPath + ".run" + std::to_string(run), readerFaces));
+    }
+
+    auto readerGreater = [&](int a, int b) {
+        return mortonLess(readers[b]->current(), readers[a]->current());
+    };
+    std::priority_queue<int, std::vector<int>, decltype(readerGreater)> nextReader(readerGreater);
+    for (int run = 0; run < runCount; run++) {
+        if (!readers[run]->isDone()) {
+            nextReader.push(run);
+        }
+    }
+
+    std::ofstream indexFile(tempPath + ".indices", std::ios::binary);
+    std::ofstream nodeFile(tempPath + ".nodes", std::ios::binary);
+    size_t segmentFaces = glm::clamp(memoryBudget / 2 / SEGMENT_BYTES_PER_FACE, MIN_SEGMENT_FACES, MAX_SEGMENT_FACES);
+    std::vector<MortonFace> segment;
+
+    while (!nextReader.empty()) {
+        int run = nextReader.top();
+        nextReader.pop();
+        segment.push_back(readers[run]->current());
+        readers[run]->advance();
+        if (!readers[run]->isDone()) {
+            nextReader.push(run);
+        }
+
+        if (segment.size() == segmentFaces) {
+            buildSegment(segment, maximumNumberOfFacesPerNode, indexFile, nodeFile);
+            segment.clear();
+        }
+    }
+
+    if (!segment.empty()) {
+        buildSegment(segment, maximumNumberOfFacesPerNode, indexFile, nodeFile);
+    }
+    return indexFile.good() && nodeFile.good();
+}
+
+void OutOfCoreBVHBuilder::buildSegment(std::vector<MortonFace>& faces, int maximumNumberOfFacesPerNode, std::ofstream& indexFile, std::ofstream& nodeFile) {
+    // the face i of the segment gets the vertices 3 i to 3 i + 2
+    std::vector<glm::vec3> positions;
+    std::vector<std::array<int,3>> segmentFaces;
+    std::vector<glm::vec3> centroids;
+    positions.reserve(3 * faces.size());
+    segmentFaces.reserve(faces.size());
+    centroids.reserve(faces.size());
+
+    glm::vec3 minPoint = faces[0].positions[0];
+    glm::vec3 maxPoint = faces[0].positions[0];
+    for (size_t i = 0; i < faces.size(); i++) {
+        for (int j = 0; j < 3; j++) {
+            positions.push_back(faces[i].positions[j]);
+            minPoint = glm::min(minPoint, faces[i].positions[j]);
+            maxPoint = glm::max(maxPoint, faces[i].positions[j]);
+        }
+        segmentFaces.push_back({ (int)(3 * i), (int)(3 * i + 1), (int)(3 * i + 2) });
+        centroids.push_back((faces[i].positions[0] + faces[i].positions[1] + faces[i].positions[2]) * 0.3333f);
+    }
+
+    BVHUtils bvhUtils;
+    std::vector<glm::ivec4> indices;
+    auto bvh = bvhUtils.subdivideModel(minPoint, maxPoint, segmentFaces, centroids, positions, indices, maximumNumberOfFacesPerNode);
+    std::vector<glm::vec3>().swap(positions);
+    std::vector<std::array<int,3>>().swap(segmentFaces);
+    std::vector<glm::vec3>().swap(centroids);
+
+    for (glm::ivec4& face : indices) {
+        const MortonFace& mortonFace = faces[face.x / 3];
+        face = glm::ivec4(mortonFace.indices[0], mortonFace.indices[1], mortonFace.indices[2], 0);
+    }
+    writeElements(indexFile, indices);
+
+    std::vector<BVHNode> nodes;
+    bvh->isRoot = true;
+    bvhUtils.addBVHTreeToBVHNodes(*bvh, -1, false, nodes);
+    writeElements(nodeFile, nodes);
+
+    segments.push_back({ minPoint, maxPoint, (long long)indices.size(), (long long)nodes.size() });
+}
+
+long long OutOfCoreBVHBuilder::topNodeCount(size_t firstSegment, size_t lastSegment) const {
+    if (lastSegment - firstSegment == 1) {
+        return segments[firstSegment].nodeCount;
+    }
+
+    size_t middleSegment = (firstSegment + lastSegment) / 2;
+    return 1 + topNodeCount(firstSegment, middleSegment) + topNodeCount(middleSegment, lastSegment);
+}
+
+// Writes the nodes of the segments firstSegment to lastSegment in the order of addBVHTreeToBVHNodes: a node,
+// its left subtree and its right subtree. The nodes of a segment are moved behind the nodes and faces before it
+void OutOfCoreBVHBuilder::writeTopLevels(size_t firstSegment, size_t lastSegment, int missIndex, long long& nodeIndex, long long& faceOffset,
+                                         std::ifstream& segmentNodes, std::ofstream& file) const {
+    if (lastSegment - firstSegment == 1) {
+        const Segment& segment = segments[firstSegment];
+        std::vector<char> chunk(sizeof(BVHNode) * segment.nodeCount);
+        segmentNodes.read(chunk.data(), chunk.size());
+
+        BVHNode* nodes = (BVHNode*)chunk.data();
+        for (long long i = 0; i < segment.nodeCount; i++) {
+            nodes[i].missIndex = nodes[i].missIndex < 0 ? missIndex : (int)(nodes[i].missIndex + nodeIndex);
+            if (nodes[i].isLeaf) {
+                nodes[i].firstFaceIndex += (int)faceOffset;
+                nodes[i].lastFaceIndex += (int)faceOffset;
+            }
+        }
+        file.write(chunk.data(), chunk.size());
+
+        nodeIndex += segment.nodeCount;
+        faceOffset += segment.faceCount;
+        return;
+    }
+
+    size_t middleSegment = (firstSegment + lastSegment) / 2;
+    glm::vec3 minPoint = segments[firstSegment].minPoint;
+    glm::vec3 maxPoint = segments[firstSegment].maxPoint;
+    for (size_t i = firstSegment + 1; i < lastSegment; i++) {
+        minPoint = glm::min(minPoint, segments[i].minPoint);
+        maxPoint = glm::max(maxPoint, segments[i].maxPoint);
+    }
+
+    BVHNode node(minPoint, maxPoint, false, missIndex, 0, 0);
+    file.write((const char*)&node, sizeof(node));
+    nodeIndex++;
+
+    int rightIndex = (int)(nodeIndex + topNodeCount(firstSegment, middleSegment));
+    writeTopLevels(firstSegment, middleSegment, rightIndex, nodeIndex, faceOffset, segmentNodes, file);
+    writeTopLevels(middleSegment, lastSegment, missIndex, nodeIndex, faceOffset, segmentNodes, file);
+}
@@ -0,0 +1,75 @@
+#ifndef OUT_OF_CORE_BVH_H
+#define OUT_OF_CORE_BVH_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "model.h"
+#include "bvh_utils.h"
+
+const char* const SCENE_CACHE_DIRECTORY = "../scene_cache";
+
+const char MODEL_CACHE_MAGIC[4] = { 'M', 'B', 'V', 'H' };
+const int MODEL_CACHE_VERSION = 1;
+
+// A model of the scene cache: the header, the vertices in the order of the PLY file, the faces in the order
+// of the BVH leaves (ivec4, the 4th component is 0) and the BVH nodes. The face and node indices are relative
+// to the model, a missIndex of -1 leaves the model
+struct ModelCacheHeader {
+    char magic[4];
+    int version;
+    unsigned long long key;
+    long long vertexCount;
+    long long faceCount;
+    long long nodeCount;
+};
+
+// A face with the Morton code of its centroid, sorted on disk
+struct MortonFace {
+    uint64_t code;
+    int face;
+    int indices[3];
+    glm::vec3 positions[3];
+};
+
+// Builds the BVH of a PLY model without holding the model in memory. The faces are sorted by the Morton code
+// of their centroid in runs on disk, the merged runs are cut into segments that are subdivided in memory like
+// BVHUtils::subdivideModel, and the top levels of the tree split the segments in the middle, as in an LBVH.
+// memoryBudget bounds the buffers of every pass, the result goes straight to a model cache file.
+class OutOfCoreBVHBuilder {
+public:
+    OutOfCoreBVHBuilder(size_t memoryBudget);
+
+    // The vertices are transformed like Scene::addModel. Returns false when the model cannot be read or written
+    bool build(const char* modelFilePath, glm::vec3 offset, float scale, float angle, int maximumNumberOfFacesPerNode, unsigned long long key);
+
+    // Identifies a model in the scene cache by its file, the size and time of the file, its transform and leaf size
+    static unsigned long long modelCacheKey(const char* modelFilePath, glm::vec3 offset, float scale, float angle, int maximumNumberOfFacesPerNode);
+    static std::string modelCachePath(unsigned long long key);
+
+private:
+    struct Segment {
+        glm::vec3 minPoint;
+        glm::vec3 maxPoint;
+        long long faceCount;
+        long long nodeCount;
+    };
+
+    size_t memoryBudget;
+    std::vector<Segment> segments;
+
+    bool parseModel(const char* modelFilePath, glm::vec3 offset, float scale, float angle, const std::string& tempPath,
+                    long long& vertexCount, long long& faceCount, glm::vec3& minPoint, glm::vec3& maxPoint);
+    int writeSortedRuns(const std::string& tempPath, long long vertexCount, long long faceCount, glm::vec3 minPoint, glm::vec3 maxPoint);
+    bool buildSegments(const std::string& tempPath, int runCount, int maximumNumberOfFacesPerNode);
+    void buildSegment(std::vector<MortonFace>& faces, int maximumNumberOfFacesPerNode, std::ofstream& indexFile, std::ofstream& nodeFile);
+    long long topNodeCount(size_t firstSegment, size_t lastSegment) const;
+    void writeTopLevels(size_t firstSegment, size_t lastSegment, int missIndex, long long& nodeIndex, long long& faceOffset,
+                        std::ifstream& segmentNodes, std::ofstream& file) const;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "ray_dump.h"
+
+#include <cstring>
+#include <fstream>
+
+const char RAY_DUMP_MAGIC[4] = { 'R', 'A', 'Y', 'S' };
+const unsigned int RAY_DUMP_VERSION = 1;
+
+RayDumpHeader createRayDumpHeader(unsigned int width, unsigned int height, unsigned long long sceneHash, size_t rayCount) {
+    RayDumpHeader header;
+    std::memcpy(header.magic, RAY_DUMP_MAGIC, sizeof(header.magic));
+    header.version = RAY_DUMP_VERSION;
+    header.width = width;
+    header.height = height;
+    header.sceneHash = sceneHash;
+    header.rayCount = rayCount;
+    return header;
+}
+
+bool writeRayDump(const char* path, const RayDumpHeader& header, const std::vector<DumpedRay>& rays) {
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)rays.data(), sizeof(DumpedRay) * rays.size());
+
+    if (!file) {
+        std::cout << "Could not write the ray dump " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool readRayDump(const char* path, RayDumpHeader& header, std::vector<DumpedRay>& rays) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read((char*)&header, sizeof(header))) {
+        std::cout << "Could not read the ray dump " << path << std::endl;
+        return false;
+    }
+
+    if (std::memcmp(header.magic, RAY_DUMP_MAGIC, sizeof(header.magic)) != 0 || header.version != RAY_DUMP_VERSION) {
+        std::cout << path << " is not a ray dump of this version" << std::endl;
+        return false;
+    }
+
+    rays.resize(header.rayCount);
+    if (!file.read((char*)rays.data(), sizeof(DumpedRay) * rays.size())) {
+        std::cout << "The ray dump " << path << " is truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
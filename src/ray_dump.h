@@ -0,0 +1,41 @@
+#ifndef RAY_DUMP_H
+#define RAY_DUMP_H
+
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// Types of the dumped rays: closest hit queries (camera and bounce rays) and any hit queries (shadow rays)
+const int RAY_CLOSEST_HIT = 0;
+const int RAY_SHADOW = 1;
+
+// std430 mirror of DumpedRay in rayReplayShader.comp
+struct alignas(16) DumpedRay {
+    glm::vec3 origin;
+    float tMin;
+    glm::vec3 direction;
+    float tMax;
+    int type;
+    int pixel;
+    int pad[2];
+};
+
+// The scene of the rays is identified by sceneHash, see Scene::sceneHash
+struct RayDumpHeader {
+    char magic[4];
+    unsigned int version;
+    unsigned int width;
+    unsigned int height;
+    unsigned long long sceneHash;
+    unsigned long long rayCount;
+};
+
+// Header followed by the rays, in the order they were traced
+bool writeRayDump(const char* path, const RayDumpHeader& header, const std::vector<DumpedRay>& rays);
+bool readRayDump(const char* path, RayDumpHeader& header, std::vector<DumpedRay>& rays);
+// A header with the magic and version of this build
+RayDumpHeader createRayDumpHeader(unsigned int width, unsigned int height, unsigned long long sceneHash, size_t rayCount);
+
+#endif
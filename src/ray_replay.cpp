@@ -0,0 +1,136 @@
+#include "ray_replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "cpu/parallel_for.h"
+
+
+RayReplay::RayReplay(const std::vector<DumpedRay>& dumpedRays, const std::vector<std::string>& defines) : 
+    replayShader("../shaders/rayReplayShader.comp", defines), rays(dumpedRays) {
+
+    std::stable_partition(rays.begin(), rays.end(), [](const DumpedRay& ray) { return ray.type == RAY_CLOSEST_HIT; });
+    shadowRayOffset = std::find_if(rays.begin(), rays.end(), [](const DumpedRay& ray) { return ray.type != RAY_CLOSEST_HIT; }) - rays.begin();
+
+    glGenBuffers(1, &raySSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, raySSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DumpedRay) * glm::max<size_t>(1, rays.size()), rays.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &resultSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, resultSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::uvec4) * glm::max<size_t>(1, rays.size()), nullptr, GL_DYNAMIC_COPY);
+}
+
+RayReplay::~RayReplay() {
+    glDeleteBuffers(1, &raySSBO);
+    glDeleteBuffers(1, &resultSSBO);
+}
+
+// Waits for the dispatches, the time includes the driver overhead of the batches
+double RayReplay::replayGpu(size_t begin, size_t end) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, raySSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 18, resultSSBO);
+    replayShader.use();
+    glFinish();
+
+    auto start = std::chrono::steady_clock::now();
+    size_t batchSize = (size_t)RAY_REPLAY_GROUP_SIZE * RAY_REPLAY_MAX_GROUPS;
+    for (size_t offset = begin; offset < end; offset += batchSize) {
+        size_t count = glm::min(batchSize, end - offset);
+        replayShader.setUint("rayOffset", (unsigned int)offset);
+        replayShader.setUint("rayEnd", (unsigned int)end);
+        replayShader.dispatch((GLuint)((count + RAY_REPLAY_GROUP_SIZE - 1) / RAY_REPLAY_GROUP_SIZE), 1, 1);
+    }
+    glFinish();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double RayReplay::replayCpu(const CpuTraversal& traversal, size_t begin, size_t end, std::vector<glm::uvec4>& results) {
+    auto start = std::chrono::steady_clock::now();
+    parallelFor("replay rays", (int)(end - begin), [&](int /*thread*/, int first, int last) {
+        for (int i = first; i < last; i++) {
+            const DumpedRay& dumped = rays[begin + i];
+            Ray ray = { dumped.origin, dumped.direction };
+
+            if (dumped.type == RAY_CLOSEST_HIT) {
+                HitRecord hit = traversal.findFirstIntersection(ray);
+                results[begin + i] = glm::uvec4((unsigned int)hit.primitiveIndex, (unsigned int)hit.modelIndex, 
+                                                 glm::floatBitsToUint(hit.dist), 0u);
+            } else {
+                results[begin + i] = glm::uvec4(0u, 0u, 0u, traversal.isOccluded(ray, dumped.tMin, dumped.tMax) ? 1u : 0u);
+            }
+        }
+    });
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// FNV-1a over the hit primitives and models, or the occlusion of the shadow rays. 
+// The distances are left out, the two traversals round them differently
+static unsigned long long hitChecksum(const std::vector<glm::uvec4>& results, size_t begin, size_t end) {
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = begin; i < end; i++) {
+        for (unsigned int value : { results[i].x, results[i].y, results[i].w }) {
+            hash = (hash ^ value) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+void RayReplay::run(const CpuTraversal& traversal, int iterations) {
+    iterations = glm::max(1, iterations);
+
+    std::vector<glm::uvec4> gpuResults(rays.size());
+    std::vector<glm::uvec4> cpuResults(rays.size());
+    const char* typeNames[] = { "closest hit", "shadow" };
+    size_t ranges[2][2] = { { 0, shadowRayOffset }, { shadowRayOffset, rays.size() } };
+
+    std::cout << "Replay of " << rays.size() << " rays, median of " << iterations << " iterations" << std::endl;
+    std::cout << "rays        | traversal     |      rays |    Mrays/s |         checksum | mismatches" << std::endl;
+
+    for (int type = 0; type < 2; type++) {
+        size_t begin = ranges[type][0];
+        size_t end = ranges[type][1];
+        if (begin == end) {
+            continue;
+        }
+
+        std::vector<double> gpuTimes;
+        std::vector<double> cpuTimes;
+        for (int i = 0; i < iterations; i++) {
+            gpuTimes.push_back(replayGpu(begin, end));
+            cpuTimes.push_back(replayCpu(traversal, begin, end, cpuResults));
+        }
+
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, resultSSBO);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::uvec4) * begin, sizeof(glm::uvec4) * (end - begin), gpuResults.data() + begin);
+
+        size_t mismatches = 0;
+        for (size_t i = begin; i < end; i++) {
+            glm::uvec4 gpu = gpuResults[i];
+            glm::uvec4 cpu = cpuResults[i];
+            if (gpu.x != cpu.x || gpu.y != cpu.y || gpu.w != cpu.w) {
+                mismatches++;
+            }
+        }
+
+        const char* traversalNames[] = { "GPU threaded", "CPU single" };
+        double times[] = { median(gpuTimes), median(cpuTimes) };
+        unsigned long long checksums[] = { hitChecksum(gpuResults, begin, end), hitChecksum(cpuResults, begin, end) };
+
+        for (int implementation = 0; implementation < 2; implementation++) {
+            char line[160];
+            std::snprintf(line, sizeof(line), "%-11s | %-13s | %9zu | %10.2f | %016llx | %10zu", typeNames[type], traversalNames[implementation], 
+                          end - begin, (end - begin) / (times[implementation] * 1000.0), checksums[implementation], mismatches);
+            std::cout << line << std::endl;
+        }
+    }
+}
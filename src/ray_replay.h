@@ -0,0 +1,46 @@
+#ifndef RAY_REPLAY_H
+#define RAY_REPLAY_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "compute_shader.h"
+#include "ray_dump.h"
+
+#include "cpu/cpu_traversal.h"
+
+
+// Threads of a replay group, must match local_size_x of rayReplayShader.comp
+const int RAY_REPLAY_GROUP_SIZE = 64;
+// Largest dispatch of the replay, the rays are traced in batches of it
+const int RAY_REPLAY_MAX_GROUPS = 65535;
+
+// Traces a ray dump with the GPU traversal (the threaded BVH of pathTracingCommon.glsl) and with the CPU traversal,
+// without sampling or shading. Prints the Mrays/s of both per ray type and a checksum of their hits,
+// the two traversals must find the same hits.
+// The scene buffers (SSBOs 2 to 7) and the frame constants must be bound.
+class RayReplay {
+public:
+    // defines: the features of the scene the rays were captured in, see ShaderFeatures
+    RayReplay(const std::vector<DumpedRay>& rays, const std::vector<std::string>& defines);
+    ~RayReplay();
+
+    // Times the median of iterations replays of every ray type
+    void run(const CpuTraversal& traversal, int iterations);
+
+private:
+    ComputeShader replayShader;
+
+    GLuint raySSBO;
+    GLuint resultSSBO;
+    // rays of the same type are traced together, closest hit rays first
+    std::vector<DumpedRay> rays;
+    size_t shadowRayOffset;
+
+    double replayGpu(size_t begin, size_t end);
+    double replayCpu(const CpuTraversal& traversal, size_t begin, size_t end, std::vector<glm::uvec4>& results);
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "ray_sorting.h"
+
+#include <cstdio>
+
+static unsigned int expandBits(unsigned int v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+unsigned int rayKey(glm::vec3 origin, glm::vec3 direction, glm::vec3 sceneMin, glm::vec3 sceneMax) {
+    glm::vec3 extent = glm::max(sceneMax - sceneMin, glm::vec3(1e-5f));
+    glm::vec3 cell = glm::clamp((origin - sceneMin) / extent, glm::vec3(0.0f), glm::vec3(1.0f)) * 511.0f;
+
+    unsigned int morton = (expandBits((unsigned int)cell.x) << 2) | (expandBits((unsigned int)cell.y) << 1) | expandBits((unsigned int)cell.z);
+    unsigned int octant = (direction.x < 0 ? 4u : 0u) | (direction.y < 0 ? 2u : 0u) | (direction.z < 0 ? 1u : 0u);
+
+    return (octant << 27) | morton;
+}
+
+void radixSort(std::vector<unsigned int>& keys, std::vector<int>& order) {
+    int n = keys.size();
+    order.resize(n);
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+
+    std::vector<unsigned int> tempKeys(n);
+    std::vector<int> tempOrder(n);
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        int counts[257] = { 0 };
+        for (int i = 0; i < n; i++) {
+            counts[((keys[i] >> shift) & 0xFF) + 1]++;
+        }
+
+        // all keys share this digit, the pass would not move anything
+        if (counts[((keys.empty() ? 0 : keys[0] >> shift) & 0xFF) + 1] == n) {
+            continue;
+        }
+
+        for (int b = 0; b < 256; b++) {
+            counts[b + 1] += counts[b];
+        }
+
+        for (int i = 0; i < n; i++) {
+            int slot = counts[(keys[i] >> shift) & 0xFF]++;
+            tempKeys[slot] = keys[i];
+            tempOrder[slot] = order[i];
+        }
+
+        keys.swap(tempKeys);
+        order.swap(tempOrder);
+    }
+}
+
+RaySortingStats::RaySortingStats(const char* backendName) : backendName(backendName), sortMs{}, traceMs{}, frames{} {
+
+}
+
+void RaySortingStats::addBounce(bool sorted, int depth, double sortTime, double traceTime) {
+    if (depth < 0 || depth >= RAY_SORT_MAX_DEPTH) {
+        return;
+    }
+
+    sortMs[sorted][depth] += sortTime;
+    traceMs[sorted][depth] += traceTime;
+}
+
+void RaySortingStats::endFrame(bool sorted) {
+    frames[sorted]++;
+
+    if ((frames[0] + frames[1]) % 100 == 0) {
+        print();
+    }
+}
+
+void RaySortingStats::print() {
+    std::cout << "Ray sorting (" << backendName << "), average ms per frame over " 
+              << frames[0] << " unsorted / " << frames[1] << " sorted frames" << std::endl;
+    std::cout << "depth | unsorted trace | sorted trace + sort | net gain" << std::endl;
+
+    double unsortedTotal = 0, sortedTotal = 0;
+
+    for (int depth = 0; depth < RAY_SORT_MAX_DEPTH; depth++) {
+        double unsorted = frames[0] > 0 ? traceMs[0][depth] / frames[0] : 0.0;
+        double trace = frames[1] > 0 ? traceMs[1][depth] / frames[1] : 0.0;
+        double sort = frames[1] > 0 ? sortMs[1][depth] / frames[1] : 0.0;
+
+        unsortedTotal += unsorted;
+        sortedTotal += trace + sort;
+
+        char line[128];
+        std::snprintf(line, sizeof(line), "%5d | %14.3f | %10.3f + %6.3f | %8.3f", depth, unsorted, trace, sort, 
+                      (frames[0] > 0 && frames[1] > 0) ? unsorted - trace - sort : 0.0);
+        std::cout << line << std::endl;
+    }
+
+    char total[128];
+    std::snprintf(total, sizeof(total), "total | %14.3f | %19.3f | %8.3f", unsortedTotal, sortedTotal, 
+                  (frames[0] > 0 && frames[1] > 0) ? unsortedTotal - sortedTotal : 0.0);
+    std::cout << total << std::endl;
+}
@@ -0,0 +1,39 @@
+#ifndef RAY_SORTING_H
+#define RAY_SORTING_H
+
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// The key is the direction octant (3 bits) above the Morton code of the origin cell (3 x 9 bits).
+// The GPU bins on the top RAY_SORT_BIN_BITS bits (8 x 8 x 8 cells per octant), the CPU sorts the whole key.
+const int RAY_SORT_KEY_BITS = 30;
+const int RAY_SORT_BIN_BITS = 12;
+const int RAY_SORT_BIN_COUNT = 1 << RAY_SORT_BIN_BITS;
+const int RAY_SORT_MAX_DEPTH = 10;
+
+// Must match rayKey in raySortingCommon.glsl
+unsigned int rayKey(glm::vec3 origin, glm::vec3 direction, glm::vec3 sceneMin, glm::vec3 sceneMax);
+
+// LSD radix sort (4 passes of 8 bits), order receives the indices of the keys in sorted order
+void radixSort(std::vector<unsigned int>& keys, std::vector<int>& order);
+
+// Per bounce depth timings of sorted and unsorted frames, so the net gain of the sort can be compared
+class RaySortingStats {
+public:
+    RaySortingStats(const char* backendName);
+
+    void addBounce(bool sorted, int depth, double sortMs, double traceMs);
+    void endFrame(bool sorted);
+    void print();
+
+private:
+    const char* backendName;
+    double sortMs[2][RAY_SORT_MAX_DEPTH];
+    double traceMs[2][RAY_SORT_MAX_DEPTH];
+    int frames[2];
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "sampling.h"
+
+unsigned int hashValue(unsigned int v) {
+    unsigned int state = v * 747796405u + 2891336453u;
+    unsigned int word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+    return (word >> 22) ^ word;
+}
+
+static unsigned int hashCombine(unsigned int seed, unsigned int v) {
+    return seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+static unsigned int reverseBits(unsigned int x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+static unsigned int laineKarrasPermutation(unsigned int x, unsigned int seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+static unsigned int nestedUniformScramble(unsigned int x, unsigned int seed) {
+    return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+// Second Sobol dimension, the first one is reverseBits(index)
+static unsigned int sobol1(unsigned int index) {
+    unsigned int result = 0;
+    for (unsigned int v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+        if (index & 1) {
+            result ^= v;
+        }
+    }
+    return result;
+}
+
+static float toUnitFloat(unsigned int x) {
+    return float(x >> 8) / 16777216.0f;
+}
+
+static float sampleDimension(const SamplerState& samplerState, unsigned int dimension) {
+    unsigned int pairSeed = hashCombine(samplerState.seed, dimension >> 1);
+    unsigned int index = nestedUniformScramble(samplerState.sampleIndex, pairSeed);
+    unsigned int x = (dimension & 1) == 0 ? reverseBits(index) : sobol1(index);
+    return toUnitFloat(nestedUniformScramble(x, hashCombine(samplerState.seed, hashValue(dimension))));
+}
+
+SamplerState createSampler(unsigned int pixelIndex, unsigned int sampleIndex, unsigned int dimension) {
+    return { hashValue(pixelIndex), sampleIndex, dimension };
+}
+
+void startBounce(SamplerState& samplerState, int depth) {
+    samplerState.dimension = SAMPLER_CAMERA_DIMENSIONS + (unsigned int)depth * SAMPLER_BOUNCE_DIMENSIONS;
+}
+
+float randomValue(SamplerState& samplerState) {
+    return sampleDimension(samplerState, samplerState.dimension++);
+}
+
+glm::vec2 randomValue2D(SamplerState& samplerState) {
+    samplerState.dimension += samplerState.dimension & 1;
+    glm::vec2 value(sampleDimension(samplerState, samplerState.dimension),
+                    sampleDimension(samplerState, samplerState.dimension + 1));
+    samplerState.dimension += 2;
+    return value;
+}
@@ -0,0 +1,26 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <glm/glm.hpp>
+
+
+// Must match the constants of samplingCommon.glsl
+const unsigned int SAMPLER_CAMERA_DIMENSIONS = 2;
+const unsigned int SAMPLER_BOUNCE_DIMENSIONS = 8;
+
+// Owen-scrambled Sobol sampler of a pixel: sampleIndex selects the point of the sequence, 
+// dimension the next coordinate to draw
+struct SamplerState {
+    unsigned int seed;
+    unsigned int sampleIndex;
+    unsigned int dimension;
+};
+
+// Ports of samplingCommon.glsl, the CPU backend draws the same samples as the shaders
+unsigned int hashValue(unsigned int v);
+SamplerState createSampler(unsigned int pixelIndex, unsigned int sampleIndex, unsigned int dimension);
+void startBounce(SamplerState& samplerState, int depth);
+float randomValue(SamplerState& samplerState);
+glm::vec2 randomValue2D(SamplerState& samplerState);
+
+#endif
@@ -1,14 +1,37 @@
 #include "scene.h"
 
 
-Scene::Scene(ComputeShader computeShader, unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT) : 
-    computeShader(computeShader), SCR_WIDTH(SCR_WIDTH), SCR_HEIGHT(SCR_HEIGHT) {
+Scene::Scene(const char* computeShaderPath, unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT, const SceneOptions& options) : 
+    computeShaderPath(computeShaderPath), options(options), SCR_WIDTH(SCR_WIDTH), SCR_HEIGHT(SCR_HEIGHT), renderWidth(SCR_WIDTH), renderHeight(SCR_HEIGHT) {
     
+    TraceScope trace("Scene");
+    stagingRing = std::make_unique<StagingRing>();
+    vertexStream = std::make_unique<StreamedBuffer>(*stagingRing);
+    indexStream = std::make_unique<StreamedBuffer>(*stagingRing);
+    bvhNodeStream = std::make_unique<StreamedBuffer>(*stagingRing);
+
+    TraceScope buildTrace("build scene");
     // testScene();
     // testScene2();
     mirrorsEveryWhere();
+    buildTrace.end();
     
+    computeSceneBounds();
+    collectLights();
     createSSBOs();
+    if (!valid) {
+        std::cout << "ERROR: the scene does not fit in the storage blocks of the driver and is not rendered" << std::endl;
+        return;
+    }
+
+    findShaderFeatures();
+    computeShader = std::make_unique<ComputeShader>(computeShaderPath, shaderFeatures.defines());
+
+    printMemoryReport();
+}
+
+bool Scene::isValid() const {
+    return valid;
 }
 
 Scene::~Scene() {
@@ -16,33 +39,189 @@ Scene::~Scene() {
     glDeleteBuffers(1, &vertexSSBO); 
     glDeleteBuffers(1, &indexSSBO); 
     glDeleteBuffers(1, &materialSSBO); 
+    glDeleteBuffers(1, &bvhNodeSSBO); 
     glDeleteBuffers(1, &modelInfoSSBO); 
-    glDeleteBuffers(1, &thisFrameTex); 
-    glDeleteBuffers(1, &lastFrameTex);
+    glDeleteBuffers(1, &lightSSBO); 
+    glDeleteTextures(1, &thisFrameTex); 
+    glDeleteTextures(1, &lastFrameTex);
 }
 
-GLuint Scene::renderScene(glm::vec3 cameraPos, glm::mat4x4 viewMatrix, bool accumulateFrames, int frameCounter) {
+void Scene::resize(unsigned int width, unsigned int height) {
+    if (width == SCR_WIDTH && height == SCR_HEIGHT) {
+        return;
+    }
+
+    SCR_WIDTH = width;
+    SCR_HEIGHT = height;
+
+    for (GLuint texture : { thisFrameTex, lastFrameTex }) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, nullptr);
+    }
+
+    // the passes allocate their buffers for the largest frame, they are created again when next used
+    adaptiveSampler.reset();
+    wavefrontPathTracer.reset();
+    cpuPathTracer.reset();
+    gBuffer.reset();
+    temporalReprojection.reset();
+    denoiser.reset();
+    traversalStats.reset();
+}
+
+void Scene::bindSceneBuffers() {
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sphereSSBO);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, vertexSSBO);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, indexSSBO);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, materialSSBO);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, bvhNodeSSBO);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, modelInfoSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, lightSSBO);
+    bindGeometryPages();
+}
+
+static GLint64 bufferSize(GLuint buffer) {
+    GLint64 size = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glGetBufferParameteri64v(GL_SHADER_STORAGE_BUFFER, GL_BUFFER_SIZE, &size);
+    return size;
+}
 
-    computeShader.use();
+// Largest power of two element count whose pages fit in a storage block. The pages must start at multiples
+// of the offset alignment of the bindings, which only makes the pages of very small blocks larger
+static GeometryPaging findPaging(const char* name, GLint64 bufferBytes, size_t elementSize, GLint64 maxBlockSize, GLint alignment) {
+    GeometryPaging paging;
+    paging.bufferBytes = bufferBytes;
+    if (bufferBytes <= maxBlockSize) {
+        return paging;
+    }
 
-    computeShader.setVec3("cameraPosition", cameraPos);
-    computeShader.setMat4("viewMatrix", viewMatrix);
+    while ((GLint64)elementSize << (paging.shift + 1) <= maxBlockSize && paging.shift < 30) {
+        paging.shift++;
+    }
+    while (((GLint64)elementSize << paging.shift) % alignment != 0) {
+        paging.shift++;
+    }
+    GLint64 pageBytes = (GLint64)elementSize << paging.shift;
+    paging.pages = (int)((bufferBytes + pageBytes - 1) / pageBytes);
+    if (paging.pages > MAX_GEOMETRY_PAGES) {
+        std::cout << "ERROR: the " << name << " need " << paging.pages << " pages of " << pageBytes << " bytes, the kernels bind " 
+                  << MAX_GEOMETRY_PAGES << " at most" << std::endl;
+    }
+    return paging;
+}
+
+// Pages the geometry buffers that do not fit in one storage block of the driver. Returns false when the kernels
+// cannot bind all the pages, they would read the wrong geometry
+bool Scene::findGeometryPages() {
+    GLint64 maxBlockSize = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+    if (options.storageBlockSize > 0) {
+        maxBlockSize = glm::min(maxBlockSize, (GLint64)options.storageBlockSize);
+    }
 
-    computeShader.setInt("width", SCR_WIDTH);
-    computeShader.setInt("height", SCR_HEIGHT);
-    computeShader.setInt("numberOfSpheres", spheres.size());
-    computeShader.setInt("numberOfModels", modelInfos.size());
+    GLint alignment = 1;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
 
-    computeShader.setInt("frameCounter", frameCounter);
-    computeShader.setBool("accumulateFrames", accumulateFrames);
+    shaderFeatures.vertexPaging = findPaging("vertices", bufferSize(vertexSSBO), sizeof(Vertex), maxBlockSize, alignment);
+    shaderFeatures.indexPaging = findPaging("indices", bufferSize(indexSSBO), sizeof(glm::ivec4), maxBlockSize, alignment);
+    shaderFeatures.bvhNodePaging = findPaging("BVH nodes", bufferSize(bvhNodeSSBO), sizeof(BVHNode), maxBlockSize, alignment);
 
-    if (accumulateFrames) {
+    int extraPages = shaderFeatures.vertexPaging.pages + shaderFeatures.indexPaging.pages + shaderFeatures.bvhNodePaging.pages - 3;
+    if (extraPages == 0) {
+        return true;
+    }
+
+    std::cout << "Geometry pages of " << maxBlockSize << " bytes at most: vertices " << shaderFeatures.vertexPaging.pages 
+              << ", indices " << shaderFeatures.indexPaging.pages << ", BVH nodes " << shaderFeatures.bvhNodePaging.pages << std::endl;
+
+    // every page is a storage block of the kernels, and most drivers only allow 16 per kernel
+    GLint maxBindings = 0;
+    GLint maxComputeBlocks = 0;
+    GLint neededBindings = BVH_NODE_PAGE_BINDING + MAX_GEOMETRY_PAGES - 1;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    glGetIntegerv(GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS, &maxComputeBlocks);
+    bool fits = shaderFeatures.vertexPaging.pages <= MAX_GEOMETRY_PAGES && shaderFeatures.indexPaging.pages <= MAX_GEOMETRY_PAGES
+                && shaderFeatures.bvhNodePaging.pages <= MAX_GEOMETRY_PAGES;
+    if (maxBindings < neededBindings) {
+        std::cout << "ERROR: the geometry pages need " << neededBindings << " storage buffer bindings, the driver has " << maxBindings << std::endl;
+        fits = false;
+    }
+    if (WAVEFRONT_STORAGE_BLOCKS + extraPages > maxComputeBlocks) {
+        std::cout << "ERROR: the kernels need " << WAVEFRONT_STORAGE_BLOCKS + extraPages << " storage blocks with the geometry pages, the driver allows " 
+                  << maxComputeBlocks << std::endl;
+        fits = false;
+    }
+    return fits;
+}
+
+// Page 0 goes to the binding of the whole buffer, the other pages to the page bindings
+static void bindPages(GLuint buffer, GLuint binding, GLuint pageBinding, const GeometryPaging& paging, size_t elementSize) {
+    if (paging.pages == 1) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+        return;
+    }
+
+    GLint64 pageBytes = (GLint64)elementSize << paging.shift;
+    for (int page = 0; page < paging.pages; page++) {
+        GLint64 offset = pageBytes * page;
+        GLint64 size = glm::min(pageBytes, (GLint64)paging.bufferBytes - offset);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, page == 0 ? binding : pageBinding + page - 1, buffer, offset, size);
+    }
+}
+
+void Scene::bindGeometryPages() {
+    bindPages(vertexSSBO, 3, VERTEX_PAGE_BINDING, shaderFeatures.vertexPaging, sizeof(Vertex));
+    bindPages(indexSSBO, 4, INDEX_PAGE_BINDING, shaderFeatures.indexPaging, sizeof(glm::ivec4));
+    bindPages(bvhNodeSSBO, 6, BVH_NODE_PAGE_BINDING, shaderFeatures.bvhNodePaging, sizeof(BVHNode));
+}
+
+void Scene::createCpuPathTracer() {
+    if (!cpuPathTracer) {
+        restoreHostCopies();
+        cpuTraversal = std::make_unique<CpuTraversal>(spheres, vertices, indices, materials, bvhNodes, modelInfos);
+        cpuPathTracer = std::make_unique<CpuPathTracer>(*cpuTraversal, lights, SCR_WIDTH, SCR_HEIGHT);
+    }
+}
+
+GLuint Scene::renderScene(glm::vec3 cameraPos, glm::mat4x4 viewMatrix, bool accumulateFrames, int frameCounter, const RenderSettings& renderSettings) {
+    applyBVHRefinements();
+    if (!valid) {
+        return thisFrameTex;
+    }
+    bindSceneBuffers();
+
+    // the frame is rendered into the lower left corner of the textures and upscaled when presented
+    float resolutionScale = glm::clamp(renderSettings.resolutionScale, MIN_RESOLUTION_SCALE, 1.0f);
+    unsigned int lastRenderWidth = renderWidth;
+    unsigned int lastRenderHeight = renderHeight;
+    renderWidth = glm::max(1u, (unsigned int)(SCR_WIDTH * resolutionScale + 0.5f));
+    renderHeight = glm::max(1u, (unsigned int)(SCR_HEIGHT * resolutionScale + 0.5f));
+
+    FrameConstants frameConstants;
+    frameConstants.cameraPosition = cameraPos;
+    frameConstants.viewMatrix = viewMatrix;
+    frameConstants.sceneMin = sceneMin;
+    frameConstants.sceneMax = sceneMax;
+    frameConstants.width = renderWidth;
+    frameConstants.height = renderHeight;
+    frameConstants.numberOfSpheres = spheres.size();
+    frameConstants.numberOfModels = modelInfos.size();
+    frameConstants.numberOfLights = lights.size();
+    frameConstants.totalLightArea = totalLightArea;
+    frameConstants.frameCounter = frameCounter;
+    frameConstants.accumulateFrames = accumulateFrames;
+    frameConstants.samplesPerPixel = glm::clamp(renderSettings.samplesPerPixel, 1, MAX_SAMPLES_PER_PIXEL);
+    frameConstants.adaptiveSampling = renderSettings.adaptiveSampling && accumulateFrames;
+    frameConstants.adaptiveThreshold = renderSettings.adaptiveThreshold;
+
+    // without the accumulation every frame draws new samples, so the reprojected history converges
+    bool temporal = renderSettings.temporalReprojection && !accumulateFrames;
+    frameConstants.sequenceFrame = accumulateFrames ? frameCounter : (temporal ? temporalFrame++ : 0);
+    frameConstants.writeGBuffer = temporal || renderSettings.denoise;
+    // the wavefront stages have no counters
+    bool heatmap = renderSettings.traversalHeatmap && renderSettings.backend != WAVEFRONT;
+    frameConstants.countTraversal = heatmap && renderSettings.backend == CPU;
+    frameConstantsBuffer.upload(frameConstants);
+
+    if (accumulateFrames || temporal) {
         GLuint tempFrame = thisFrameTex;
         thisFrameTex = lastFrameTex;
         lastFrameTex = tempFrame;
@@ -51,11 +230,318 @@ GLuint Scene::renderScene(glm::vec3 cameraPos, glm::mat4x4 viewMatrix, bool accu
     glBindImageTexture(0, thisFrameTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
     glBindImageTexture(1, lastFrameTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
 
-    computeShader.dispatch(SCR_WIDTH / 8, SCR_HEIGHT / 8, 1);
+    if (frameConstants.writeGBuffer) {
+        if (!gBuffer) {
+            gBuffer = std::make_unique<GBuffer>(SCR_WIDTH, SCR_HEIGHT);
+        }
+
+        gBuffer->bind();
+    }
+
+    if (heatmap) {
+        if (!traversalStats) {
+            traversalStats = std::make_unique<TraversalStats>(SCR_WIDTH, SCR_HEIGHT);
+        }
+
+        traversalStats->bind(frameConstants);
+    }
+
+    if (temporal && !temporalReprojection) {
+        temporalReprojection = std::make_unique<TemporalReprojection>(SCR_WIDTH, SCR_HEIGHT);
+    } else if (temporalReprojection && (!temporal || renderWidth != lastRenderWidth || renderHeight != lastRenderHeight)) {
+        temporalReprojection->reset();
+    }
+
+    // the CPU backend keeps its own statistics
+    GLuint activePixelSSBO = 0;
+    if (frameConstants.adaptiveSampling && renderSettings.backend != CPU) {
+        if (!adaptiveSampler) {
+            adaptiveSampler = std::make_unique<AdaptiveSampler>(SCR_WIDTH, SCR_HEIGHT);
+        }
+
+        adaptiveSampler->update(frameConstants);
+        activePixelSSBO = adaptiveSampler->activePixelBuffer();
+    }
+
+    if (renderSettings.backend == WAVEFRONT) {
+        if (!wavefrontPathTracer) {
+            wavefrontPathTracer = std::make_unique<WavefrontPathTracer>(SCR_WIDTH, SCR_HEIGHT, shaderFeatures.defines());
+        }
+
+        wavefrontPathTracer->render(frameConstants, renderSettings.sortRays, activePixelSSBO);
+    } else if (renderSettings.backend == CPU) {
+        createCpuPathTracer();
+        const std::vector<glm::vec4>& frame = cpuPathTracer->render(frameConstants, renderSettings.sortRays);
+
+        glBindTexture(GL_TEXTURE_2D, thisFrameTex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, renderWidth, renderHeight, GL_RGBA, GL_FLOAT, frame.data());
+
+        if (frameConstants.writeGBuffer) {
+            gBuffer->upload(frameConstants, cpuPathTracer->firstHits(), cpuPathTracer->firstHitMaterials());
+        }
+
+        if (heatmap) {
+            traversalStats->upload(frameConstants, cpuPathTracer->pixelTraversalCosts());
+        }
+    } else {
+        if (heatmap && !traversalStatsShader) {
+            std::vector<std::string> defines = shaderFeatures.defines();
+            defines.push_back("TRAVERSAL_STATS 1");
+            traversalStatsShader = std::make_unique<ComputeShader>(computeShaderPath.c_str(), defines);
+        }
+
+        ComputeShader& megakernel = heatmap ? *traversalStatsShader : *computeShader;
+        megakernel.use();
+
+        if (frameConstants.adaptiveSampling) {
+            megakernel.dispatchIndirect(activePixelSSBO);
+        } else {
+            megakernel.dispatchImage(renderWidth, renderHeight);
+        }
+    }
+
+    if (temporal) {
+        temporalReprojection->resolve(frameConstants, thisFrameTex, lastFrameTex);
+    }
+
+    if (heatmap) {
+        return traversalStats->resolve(frameConstants, renderSettings.traversalMetric);
+    }
+
+    // the filtered frame is only shown, the next frames build on the noisy one
+    if (renderSettings.denoise) {
+        if (!denoiser) {
+            denoiser = std::make_unique<Denoiser>(SCR_WIDTH, SCR_HEIGHT);
+        }
+
+        return denoiser->denoise(frameConstants, thisFrameTex, temporal ? temporalReprojection->momentsTexture() : 0);
+    }
     
     return thisFrameTex;
 }
 
+// The frame is not accumulated and draws the first samples of the sequences, so the same view always gives the same rays
+bool Scene::captureRays(const char* path, glm::vec3 cameraPos, glm::mat4x4 viewMatrix, const RenderSettings& renderSettings) {
+    RenderSettings captureSettings = renderSettings;
+    captureSettings.backend = CPU;
+    captureSettings.samplesPerPixel = 1;
+    captureSettings.temporalReprojection = false;
+    captureSettings.denoise = false;
+    captureSettings.traversalHeatmap = false;
+
+    std::vector<DumpedRay> rays;
+    createCpuPathTracer();
+    cpuPathTracer->captureRays(&rays);
+    renderScene(cameraPos, viewMatrix, false, 0, captureSettings);
+    cpuPathTracer->captureRays(nullptr);
+
+    if (!writeRayDump(path, createRayDumpHeader(renderWidth, renderHeight, sceneHash(), rays.size()), rays)) {
+        return false;
+    }
+
+    std::cout << "Captured " << rays.size() << " rays of a " << renderWidth << " x " << renderHeight << " frame in " << path << std::endl;
+    return true;
+}
+
+void Scene::replayRays(const char* path, int iterations) {
+    RayDumpHeader header;
+    std::vector<DumpedRay> rays;
+    if (!readRayDump(path, header, rays)) {
+        return;
+    }
+
+    if (!valid) {
+        return;
+    }
+
+    restoreHostCopies();
+    if (header.sceneHash != sceneHash()) {
+        std::cout << "The rays of " << path << " were captured in another scene" << std::endl;
+        return;
+    }
+
+    bindSceneBuffers();
+
+    // the traversal only reads the scene part of the constants
+    FrameConstants frameConstants = {};
+    frameConstants.viewMatrix = glm::mat4(1.0f);
+    frameConstants.cameraPosition = glm::vec3(0.0f);
+    frameConstants.sceneMin = sceneMin;
+    frameConstants.sceneMax = sceneMax;
+    frameConstants.width = header.width;
+    frameConstants.height = header.height;
+    frameConstants.numberOfSpheres = spheres.size();
+    frameConstants.numberOfModels = modelInfos.size();
+    frameConstants.numberOfLights = lights.size();
+    frameConstants.totalLightArea = totalLightArea;
+    frameConstantsBuffer.upload(frameConstants);
+
+    CpuTraversal traversal(spheres, vertices, indices, materials, bvhNodes, modelInfos);
+    RayReplay replay(rays, shaderFeatures.defines());
+    replay.run(traversal, iterations);
+}
+
+// FNV-1a, over the fields only: the structs of the buffers have uninitialized padding
+static unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+unsigned long long Scene::sceneHash() {
+    restoreHostCopies();
+
+    unsigned long long hash = 14695981039346656037ull;
+    for (const Sphere& sphere : spheres) {
+        hash = hashBytes(hash, &sphere.center, sizeof(glm::vec3));
+        hash = hashBytes(hash, &sphere.radius, sizeof(float));
+    }
+    for (const Vertex& vertex : vertices) {
+        float position[3] = { vertex.x, vertex.y, vertex.z };
+        hash = hashBytes(hash, position, sizeof(position));
+    }
+    hash = hashBytes(hash, indices.data(), sizeof(glm::ivec4) * indices.size());
+    for (const BVHNode& node : bvhNodes) {
+        int links[3] = { node.firstFaceIndex, node.lastFaceIndex, node.missIndex };
+        hash = hashBytes(hash, &node.minVertPos, sizeof(glm::vec3));
+        hash = hashBytes(hash, &node.maxVertPos, sizeof(glm::vec3));
+        hash = hashBytes(hash, links, sizeof(links));
+    }
+    hash = hashBytes(hash, modelInfos.data(), sizeof(ModelInfo) * modelInfos.size());
+    return hash;
+}
+
+// Replaces the host copy with the content of the GPU buffer. The scene buffers cannot be mapped,
+// so they are read a staging chunk at a time
+template<typename T>
+static void readBackBuffer(GLuint buffer, std::vector<T>& hostCopy) {
+    size_t count = bufferSize(buffer) / sizeof(T);
+    size_t chunkCount = STAGING_CHUNK_SIZE / sizeof(T);
+    std::vector<char> chunk(sizeof(T) * chunkCount);
+
+    hostCopy.clear();
+    hostCopy.reserve(count);
+    for (size_t first = 0; first < count; first += chunkCount) {
+        size_t part = glm::min(chunkCount, count - first);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(T) * first, sizeof(T) * part, chunk.data());
+        hostCopy.insert(hostCopy.end(), (const T*)chunk.data(), (const T*)chunk.data() + part);
+    }
+}
+
+void Scene::printMemoryReport() const {
+    struct BufferBytes {
+        const char* name;
+        size_t elements;
+        size_t hostBytes;
+        GLint64 gpuBytes;
+    };
+
+    // the host copies of the released buffers are empty
+    BufferBytes buffers[] = {
+        { "spheres", spheres.size(), sizeof(Sphere) * spheres.capacity(), bufferSize(sphereSSBO) },
+        { "vertices", vertices.size(), sizeof(Vertex) * vertices.capacity(), bufferSize(vertexSSBO) },
+        { "indices", indices.size(), sizeof(glm::ivec4) * indices.capacity(), bufferSize(indexSSBO) },
+        { "materials", materials.size(), sizeof(Material) * materials.capacity(), bufferSize(materialSSBO) },
+        { "BVH nodes", bvhNodes.size(), sizeof(BVHNode) * bvhNodes.capacity(), bufferSize(bvhNodeSSBO) },
+        { "model infos", modelInfos.size(), sizeof(ModelInfo) * modelInfos.capacity(), bufferSize(modelInfoSSBO) },
+        { "lights", lights.size(), sizeof(Light) * lights.capacity(), bufferSize(lightSSBO) }
+    };
+
+    char line[160];
+    size_t hostTotal = 0;
+    GLint64 gpuTotal = 0;
+    std::cout << "Scene memory" << (hostCopiesReleased ? ", host copies of the geometry released" : "") << std::endl;
+    std::cout << "buffer         |   elements |   host bytes |    GPU bytes" << std::endl;
+    for (const BufferBytes& buffer : buffers) {
+        std::snprintf(line, sizeof(line), "%-14s | %10zu | %12zu | %12lld", buffer.name, buffer.elements, buffer.hostBytes, (long long)buffer.gpuBytes);
+        std::cout << line << std::endl;
+        hostTotal += buffer.hostBytes;
+        gpuTotal += buffer.gpuBytes;
+    }
+    std::snprintf(line, sizeof(line), "%-14s | %10s | %12zu | %12lld", "total", "", hostTotal, (long long)gpuTotal);
+    std::cout << line << std::endl;
+
+    struct PassBytes {
+        const char* name;
+        bool allocated;
+        GLint64 gpuBytes;
+    };
+
+    // the passes are created when first used, always for the full textures
+    PassBytes passes[] = {
+        { "frame textures", true, 2 * (GLint64)sizeof(glm::vec4) * SCR_WIDTH * SCR_HEIGHT },
+        { "G-buffer", (bool)gBuffer, GBuffer::gpuBytes(SCR_WIDTH, SCR_HEIGHT) },
+        { "temporal", (bool)temporalReprojection, TemporalReprojection::gpuBytes(SCR_WIDTH, SCR_HEIGHT) },
+        { "denoiser", (bool)denoiser, Denoiser::gpuBytes(SCR_WIDTH, SCR_HEIGHT) },
+        { "adaptive", (bool)adaptiveSampler, AdaptiveSampler::gpuBytes(SCR_WIDTH, SCR_HEIGHT) },
+        { "heatmap", (bool)traversalStats, TraversalStats::gpuBytes(SCR_WIDTH, SCR_HEIGHT) },
+        { "wavefront", (bool)wavefrontPathTracer, WavefrontPathTracer::gpuBytes(SCR_WIDTH, SCR_HEIGHT) }
+    };
+
+    GLint64 allocatedTotal = gpuTotal;
+    GLint64 passTotal = gpuTotal;
+    std::cout << "render pass    | allocated |    GPU bytes, " << SCR_WIDTH << " x " << SCR_HEIGHT << std::endl;
+    for (const PassBytes& pass : passes) {
+        std::snprintf(line, sizeof(line), "%-14s | %9s | %12lld", pass.name, pass.allocated ? "yes" : "no", (long long)pass.gpuBytes);
+        std::cout << line << std::endl;
+        allocatedTotal += pass.allocated ? pass.gpuBytes : 0;
+        passTotal += pass.gpuBytes;
+    }
+    // the scene buffers included, the second total is reached once every pass is used
+    std::snprintf(line, sizeof(line), "%-14s | %9s | %12lld", "total", "", (long long)allocatedTotal);
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "%-14s | %9s | %12lld", "all passes", "", (long long)passTotal);
+    std::cout << line << std::endl;
+
+    // the same on the GPU and, unless they are released, on the host
+    std::cout << "model | vertices |    faces | BVH nodes |  geometry bytes" << std::endl;
+    for (size_t i = 0; i < modelInfos.size(); i++) {
+        const ModelInfo& modelInfo = modelInfos[i];
+        int nodeCount = modelInfo.bvhNodeLastIndex - modelInfo.bvhNodeFirstIndex + 1;
+        size_t bytes = sizeof(Vertex) * modelInfo.vertexCount + sizeof(glm::ivec4) * modelInfo.indexCount + sizeof(BVHNode) * nodeCount;
+        std::snprintf(line, sizeof(line), "%5zu | %8d | %8d | %9d | %15zu", i, modelInfo.vertexCount, modelInfo.indexCount, nodeCount, bytes);
+        std::cout << line << std::endl;
+    }
+}
+
+void Scene::releaseHostCopies() {
+    if (hostCopiesReleased) {
+        return;
+    }
+
+    // the CPU traversal reads the host copies
+    cpuPathTracer.reset();
+    cpuTraversal.reset();
+
+    size_t bytes = sizeof(Vertex) * vertices.capacity() + sizeof(glm::ivec4) * indices.capacity() + sizeof(BVHNode) * bvhNodes.capacity();
+    std::vector<Vertex>().swap(vertices);
+    std::vector<glm::ivec4>().swap(indices);
+    std::vector<BVHNode>().swap(bvhNodes);
+    hostCopiesReleased = true;
+
+    std::cout << "Released " << bytes << " bytes of host copies" << std::endl;
+}
+
+// The GPU buffers are never written after createSSBOs, so they hold the uploaded data
+void Scene::restoreHostCopies() {
+    if (!hostCopiesReleased) {
+        return;
+    }
+
+    readBackBuffer(vertexSSBO, vertices);
+    readBackBuffer(indexSSBO, indices);
+    readBackBuffer(bvhNodeSSBO, bvhNodes);
+    hostCopiesReleased = false;
+
+    std::cout << "Read the host copies of the geometry back from the GPU buffers" << std::endl;
+}
+
+glm::vec2 Scene::getRenderScale() const {
+    return glm::vec2(float(renderWidth) / float(SCR_WIDTH), float(renderHeight) / float(SCR_HEIGHT));
+}
+
 void Scene::addQuad(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, glm::vec3 normal, Material material) {
     vertices.push_back(Vertex(v0, normal));
     vertices.push_back(Vertex(v1, normal));
@@ -88,6 +574,13 @@ void Scene::addQuad(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, glm:
 }
 
 void Scene::addModel(const char* modelFilePath, glm::vec3 offset, float scale, float angle, Material material, int maximumNumberOfFacesPerNode) {
+    std::error_code error;
+    if (options.modelMemoryBudget > 0 && (long long)std::filesystem::file_size(modelFilePath, error) > options.modelMemoryBudget) {
+        addModelOutOfCore(modelFilePath, offset, scale, angle, material, maximumNumberOfFacesPerNode);
+        return;
+    }
+
+    TraceScope trace("addModel");
     
     ModelUtils modelUtils;
     // Model model = modelUtils.createModelFromPLY(modelFilePath, false);
@@ -99,6 +592,10 @@ void Scene::addModel(const char* modelFilePath, glm::vec3 offset, float scale, f
 
     materials.push_back(material);
 
+    // the bytes of the transformed vertices and of the faces with their centroids
+    TraceScope transformTrace("addModel transform and centroids", 
+                              (sizeof(Vertex) + sizeof(glm::vec3)) * mod.vertices.size() + (sizeof(std::array<int,3>) + sizeof(glm::vec3)) * mod.faces.size());
+
     float minX = 1000000;
     float minY = 1000000;
     float minZ = 1000000;
@@ -163,30 +660,225 @@ void Scene::addModel(const char* modelFilePath, glm::vec3 offset, float scale, f
         centroids.push_back((glm::vec3(x0, y0, z0) + glm::vec3(x1, y1, z1) + glm::vec3(x2, y2, z2)) * 0.3333f);
     }
 
+    transformTrace.end();
+
     std::cout << "Number of vertices: " << modifiedVertexPositions.size() << std::endl;
     std::cout << "Number of faces: " << modelFaces.size() << std::endl;
 
+    // the transformed copies replace the model from here on
+    int modelVertexCount = mod.vertices.size();
+    int modelFaceCount = mod.faces.size();
+    mod = Model();
+
     int lastFaceIndex = indices.size() - 1;
 
     int bvhNodeIndex = bvhNodes.size();
 
     BVHUtils bvhUtils;
 
-    auto bvh = bvhUtils.subdivideModel(glm::vec3(minX, minY, minZ), glm::vec3(maxX, maxY, maxZ), 
-                                        modelFaces, centroids, modifiedVertexPositions, indices, maximumNumberOfFacesPerNode);
+    std::unique_ptr<BVHTree> bvh;
+    if (options.progressiveBVH) {
+        // the model is traced through the LBVH until its SAH tree is built
+        TraceScope lbvhTrace("buildLBVH", sizeof(glm::ivec4) * modelFaces.size());
+        bvh = bvhUtils.buildLBVH(modelFaces, centroids, modifiedVertexPositions, indices, maximumNumberOfFacesPerNode);
+        lbvhTrace.end();
+        bvhRefinements.push_back(std::make_unique<BVHRefinement>(modelInfos.size(), std::move(modifiedVertexPositions), 
+                                                                 std::move(modelFaces), std::move(centroids), maximumNumberOfFacesPerNode));
+    } else {
+        TraceScope subdivideTrace("subdivideModel", sizeof(glm::ivec4) * modelFaces.size());
+        bvh = bvhUtils.subdivideModel(glm::vec3(minX, minY, minZ), glm::vec3(maxX, maxY, maxZ), 
+                                      modelFaces, centroids, modifiedVertexPositions, indices, maximumNumberOfFacesPerNode);
+        subdivideTrace.end();
+    }
+
+    // the faces are in indices now, in the order of the leaves
+    std::vector<glm::vec3>().swap(modifiedVertexPositions);
+    std::vector<std::array<int,3>>().swap(modelFaces);
+    std::vector<glm::vec3>().swap(centroids);
 
     BVHTree& bvhTree = *bvh; 
     bvhTree.isRoot = true;
+    TraceScope flattenTrace("addBVHTreeToBVHNodes");
     bvhUtils.addBVHTreeToBVHNodes(bvhTree, -1, false, bvhNodes);
+    flattenTrace.setBytes(sizeof(BVHNode) * (bvhNodes.size() - bvhNodeIndex));
+    flattenTrace.end();
+    bvh.reset();
 
-    ModelInfo modModelInfo(mod.vertices.size(), mod.faces.size(), modelInfos.size(), bvhNodeIndex, bvhNodes.size() - 1);
+    ModelInfo modModelInfo(modelVertexCount, modelFaceCount, modelInfos.size(), bvhNodeIndex, bvhNodes.size() - 1);
     modelInfos.push_back(modModelInfo);
 
-    //empty modifiedVertexPositions, bvhTree, modelFaces, centroids
+    // copied to the GPU while the next model is parsed
+    streamGeometry();
 
     // mod.transferDataToGPU();
 }
 
+// The scene buffers have immutable storage, so a buffer whose content changes is created again
+template<typename T>
+static void replaceSSBO(GLuint& ssbo, const std::vector<T>& data) {
+    glDeleteBuffers(1, &ssbo);
+    ssbo = createDeviceBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(T) * data.size(), data.data());
+}
+
+// Swaps the SAH trees that are built in for the LBVHs of their models. The nodes of the models after them move,
+// so the node, face and model info buffers are all replaced before the frame binds them
+void Scene::applyBVHRefinements() {
+    std::vector<const BVHRefinement*> refined(modelInfos.size(), nullptr);
+    bool anyRefined = false;
+    for (const std::unique_ptr<BVHRefinement>& refinement : bvhRefinements) {
+        if (refinement->isDone()) {
+            refined[refinement->getModelIndex()] = refinement.get();
+            anyRefined = true;
+        }
+    }
+    if (!anyRefined) {
+        return;
+    }
+
+    TraceScope trace("apply BVH refinements");
+    bool released = hostCopiesReleased;
+    restoreHostCopies();
+
+    std::vector<BVHNode> refinedNodes;
+    refinedNodes.reserve(bvhNodes.size());
+    int firstFaceIndex = 0;
+    for (int i = 0; i < modelInfos.size(); i++) {
+        ModelInfo& modelInfo = modelInfos[i];
+        int bvhNodeIndex = refinedNodes.size();
+
+        if (refined[i]) {
+            // the nodes and faces of the refinement are relative to the model
+            for (BVHNode node : refined[i]->getNodes()) {
+                if (node.missIndex >= 0) {
+                    node.missIndex += bvhNodeIndex;
+                }
+                if (node.isLeaf) {
+                    node.firstFaceIndex += firstFaceIndex;
+                    node.lastFaceIndex += firstFaceIndex;
+                }
+                refinedNodes.push_back(node);
+            }
+            std::copy(refined[i]->getIndices().begin(), refined[i]->getIndices().end(), indices.begin() + firstFaceIndex);
+
+            std::cout << "Refined the BVH of model " << i << " in " << refined[i]->getBuildMilliseconds() << " ms: " 
+                      << modelInfo.bvhNodeLastIndex - modelInfo.bvhNodeFirstIndex + 1 << " LBVH nodes, " 
+                      << refined[i]->getNodes().size() << " SAH nodes" << std::endl;
+        } else {
+            for (int j = modelInfo.bvhNodeFirstIndex; j <= modelInfo.bvhNodeLastIndex; j++) {
+                BVHNode node = bvhNodes[j];
+                if (node.missIndex >= 0) {
+                    node.missIndex += bvhNodeIndex - modelInfo.bvhNodeFirstIndex;
+                }
+                refinedNodes.push_back(node);
+            }
+        }
+
+        modelInfo.bvhNodeFirstIndex = bvhNodeIndex;
+        modelInfo.bvhNodeLastIndex = refinedNodes.size() - 1;
+        firstFaceIndex += modelInfo.indexCount;
+    }
+    bvhNodes.swap(refinedNodes);
+
+    // a refinement that finished since the check above waits for the next frame
+    bvhRefinements.erase(std::remove_if(bvhRefinements.begin(), bvhRefinements.end(), [&](const std::unique_ptr<BVHRefinement>& refinement) {
+        return refined[refinement->getModelIndex()] == refinement.get();
+    }), bvhRefinements.end());
+
+    replaceSSBO(indexSSBO, indices);
+    replaceSSBO(bvhNodeSSBO, bvhNodes);
+    replaceSSBO(modelInfoSSBO, modelInfos);
+    // the CPU traversal reads the host copies, which changed in place
+
+    // a larger node buffer may need other pages, and so other kernels
+    std::vector<std::string> defines = shaderFeatures.defines();
+    valid = findGeometryPages();
+    if (!valid) {
+        std::cout << "ERROR: the refined BVH does not fit in the storage blocks of the driver, the scene is not rendered any more" << std::endl;
+    } else if (shaderFeatures.defines() != defines) {
+        computeShader = std::make_unique<ComputeShader>(computeShaderPath.c_str(), shaderFeatures.defines());
+        traversalStatsShader.reset();
+        wavefrontPathTracer.reset();
+    }
+
+    if (released) {
+        releaseHostCopies();
+    }
+}
+
+// The model is built once by OutOfCoreBVHBuilder into the scene cache, the next runs only load it
+void Scene::addModelOutOfCore(const char* modelFilePath, glm::vec3 offset, float scale, float angle, Material material, int maximumNumberOfFacesPerNode) {
+    TraceScope trace("addModelOutOfCore");
+    unsigned long long key = OutOfCoreBVHBuilder::modelCacheKey(modelFilePath, offset, scale, angle, maximumNumberOfFacesPerNode);
+    if (loadModelCache(key, material)) {
+        std::cout << "Loaded " << modelFilePath << " from the scene cache" << std::endl;
+        return;
+    }
+
+    OutOfCoreBVHBuilder builder(options.modelMemoryBudget);
+    if (!builder.build(modelFilePath, offset, scale, angle, maximumNumberOfFacesPerNode, key) || !loadModelCache(key, material)) {
+        std::cout << "ERROR: could not build the BVH of " << modelFilePath << " out of core" << std::endl;
+    }
+}
+
+// Appends a model of the scene cache, false when it is missing or does not match the key
+bool Scene::loadModelCache(unsigned long long key, Material material) {
+    std::ifstream file(OutOfCoreBVHBuilder::modelCachePath(key), std::ios::binary);
+    ModelCacheHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic)) != 0 || 
+        header.version != MODEL_CACHE_VERSION || header.key != key) {
+        return false;
+    }
+    if (header.vertexCount > INT_MAX || header.faceCount > INT_MAX || header.nodeCount <= 0 || header.nodeCount > INT_MAX) {
+        std::cout << "ERROR: the model cache of " << header.vertexCount << " vertices and " << header.faceCount << " faces is too large" << std::endl;
+        return false;
+    }
+
+    TraceScope trace("loadModelCache", sizeof(Vertex) * header.vertexCount + sizeof(glm::ivec4) * header.faceCount + sizeof(BVHNode) * header.nodeCount);
+    size_t firstVertex = vertices.size();
+    size_t firstFaceIndex = indices.size();
+    size_t bvhNodeIndex = bvhNodes.size();
+
+    vertices.resize(firstVertex + header.vertexCount);
+    file.read((char*)(vertices.data() + firstVertex), sizeof(Vertex) * header.vertexCount);
+    indices.resize(firstFaceIndex + header.faceCount);
+    file.read((char*)(indices.data() + firstFaceIndex), sizeof(glm::ivec4) * header.faceCount);
+
+    // the node and face indices of the cache are relative to the model
+    std::vector<char> chunk(sizeof(BVHNode) * header.nodeCount);
+    file.read(chunk.data(), chunk.size());
+    const BVHNode* nodes = (const BVHNode*)chunk.data();
+    bvhNodes.reserve(bvhNodeIndex + header.nodeCount);
+    for (long long i = 0; i < header.nodeCount; i++) {
+        BVHNode node = nodes[i];
+        if (node.missIndex >= 0) {
+            node.missIndex += bvhNodeIndex;
+        }
+        if (node.isLeaf) {
+            node.firstFaceIndex += firstFaceIndex;
+            node.lastFaceIndex += firstFaceIndex;
+        }
+        bvhNodes.push_back(node);
+    }
+
+    if (!file) {
+        std::cout << "ERROR: the model cache file " << OutOfCoreBVHBuilder::modelCachePath(key) << " is truncated" << std::endl;
+        vertices.resize(firstVertex);
+        indices.resize(firstFaceIndex);
+        bvhNodes.erase(bvhNodes.begin() + bvhNodeIndex, bvhNodes.end());
+        return false;
+    }
+
+    std::cout << "Number of vertices: " << header.vertexCount << std::endl;
+    std::cout << "Number of faces: " << header.faceCount << std::endl;
+
+    materials.push_back(material);
+    modelInfos.push_back(ModelInfo(header.vertexCount, header.faceCount, modelInfos.size(), bvhNodeIndex, bvhNodes.size() - 1));
+
+    // copied to the GPU while the next model is parsed
+    streamGeometry();
+    return true;
+}
+
 void Scene::createCornellBox(glm::vec3 center, glm::vec3 size, std::vector<Material> materials) {
     glm::vec3 a = center + glm::vec3(-size.x, -size.y, -size.z) / 2.0f;
     glm::vec3 b = center + glm::vec3(-size.x, -size.y,  size.z) / 2.0f;
@@ -236,49 +928,156 @@ void Scene::createCornellBox(glm::vec3 center, glm::vec3 size, std::vector<Mater
     // spheres.push_back(hS);
 }
 
-void Scene::createSSBOs() {
-    glGenBuffers(1, &sphereSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, sphereSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Sphere) * spheres.size(), spheres.data(), GL_DYNAMIC_COPY);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sphereSSBO);
+void Scene::computeSceneBounds() {
+    sceneMin = glm::vec3(1e+5f);
+    sceneMax = glm::vec3(-1e+5f);
 
-    glGenBuffers(1, &vertexSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, vertexSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_DYNAMIC_COPY);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, vertexSSBO);
+    for (const ModelInfo& modelInfo : modelInfos) {
+        sceneMin = glm::min(sceneMin, bvhNodes[modelInfo.bvhNodeFirstIndex].minVertPos);
+        sceneMax = glm::max(sceneMax, bvhNodes[modelInfo.bvhNodeFirstIndex].maxVertPos);
+    }
 
-    glGenBuffers(1, &indexSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4) * indices.size(), indices.data(), GL_DYNAMIC_COPY);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, indexSSBO);
+    for (const Sphere& sphere : spheres) {
+        sceneMin = glm::min(sceneMin, sphere.center - glm::vec3(sphere.radius));
+        sceneMax = glm::max(sceneMax, sphere.center + glm::vec3(sphere.radius));
+    }
+}
 
-    glGenBuffers(1, &materialSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Material) * materials.size(), materials.data(), GL_DYNAMIC_COPY);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, materialSSBO);
+void Scene::collectLights() {
+    lights.clear();
+    totalLightArea = 0;
 
-    glGenBuffers(1, &bvhNodeSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bvhNodeSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(BVHNode) * bvhNodes.size(), bvhNodes.data(), GL_DYNAMIC_COPY);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, bvhNodeSSBO);
+    int vertexOffset = 0;
+    int faceOffset = 0;
 
-    glGenBuffers(1, &modelInfoSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, modelInfoSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ModelInfo) * modelInfos.size(), modelInfos.data(), GL_DYNAMIC_COPY);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, modelInfoSSBO);
+    for (int i = 0; i < modelInfos.size(); i++) {
+        const Material& material = materials[i];
+        glm::vec3 emission = material.emissionColor * material.emissionStrength;
+
+        if (material.emissionStrength > 0 && material.refractionProbability == 0) {
+            for (int j = faceOffset; j < faceOffset + modelInfos[i].indexCount; j++) {
+                const Vertex& a = vertices[indices[j].x + vertexOffset];
+                const Vertex& b = vertices[indices[j].y + vertexOffset];
+                const Vertex& c = vertices[indices[j].z + vertexOffset];
+
+                glm::vec3 v0(a.x, a.y, a.z);
+                glm::vec3 v1(b.x, b.y, b.z);
+                glm::vec3 v2(c.x, c.y, c.z);
+
+                float area = 0.5f * glm::length(glm::cross(v1 - v0, v2 - v0));
+                if (area > 0) {
+                    lights.push_back(Light(LIGHT_TRIANGLE, v0, v1, v2, area, emission));
+                }
+            }
+        }
+
+        vertexOffset += modelInfos[i].vertexCount;
+        faceOffset += modelInfos[i].indexCount;
+    }
+
+    for (const Sphere& sphere : spheres) {
+        if (sphere.material.emissionStrength > 0 && sphere.material.refractionProbability == 0) {
+            float area = 4.0f * 3.14159265f * sphere.radius * sphere.radius;
+            lights.push_back(Light(LIGHT_SPHERE, sphere.center, glm::vec3(sphere.radius, 0, 0), glm::vec3(0), area, 
+                                   sphere.material.emissionColor * sphere.material.emissionStrength));
+        }
+    }
+
+    for (Light& light : lights) {
+        totalLightArea += light.area;
+        light.cdf = totalLightArea;
+    }
+
+    for (Light& light : lights) {
+        light.cdf /= totalLightArea;
+    }
+
+    std::cout << "Number of lights: " << lights.size() << std::endl;
+}
+
+void Scene::findShaderFeatures() {
+    shaderFeatures.spheres = !spheres.empty();
+
+    shaderFeatures.refraction = false;
+    for (const Material& material : materials) {
+        shaderFeatures.refraction |= material.refractionProbability > 0;
+    }
+    for (const Sphere& sphere : spheres) {
+        shaderFeatures.refraction |= sphere.material.refractionProbability > 0;
+    }
+
+    shaderFeatures.maxLeafFaces = 0;
+    for (const BVHNode& node : bvhNodes) {
+        if (node.isLeaf) {
+            shaderFeatures.maxLeafFaces = glm::max(shaderFeatures.maxLeafFaces, node.lastFaceIndex - node.firstFaceIndex + 1);
+        }
+    }
+
+    // the refined trees are swapped in without compiling the kernels again
+    for (const std::unique_ptr<BVHRefinement>& refinement : bvhRefinements) {
+        shaderFeatures.maxLeafFaces = glm::max(shaderFeatures.maxLeafFaces, refinement->getMaximumLeafFaces());
+    }
+
+    std::cout << "Shader features: spheres " << (shaderFeatures.spheres ? "ON" : "OFF") 
+              << ", refraction " << (shaderFeatures.refraction ? "ON" : "OFF") 
+              << ", faces per leaf " << shaderFeatures.maxLeafFaces << std::endl;
+}
+
+// Creates a scene buffer and uploads data to it
+static GLuint createSSBO(const char* name, GLuint binding, const void* data, GLsizeiptr size) {
+    TraceScope trace(name, size);
+
+    GLuint ssbo = createDeviceBuffer(GL_SHADER_STORAGE_BUFFER, size, data);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, ssbo);
+    return ssbo;
+}
+
+// Appends the geometry added since the last call to the streamed buffers
+void Scene::streamGeometry() {
+    size_t streamedVertices = vertexStream->size() / sizeof(Vertex);
+    size_t streamedIndices = indexStream->size() / sizeof(glm::ivec4);
+    size_t streamedBvhNodes = bvhNodeStream->size() / sizeof(BVHNode);
+
+    vertexStream->append(vertices.data() + streamedVertices, sizeof(Vertex) * (vertices.size() - streamedVertices));
+    indexStream->append(indices.data() + streamedIndices, sizeof(glm::ivec4) * (indices.size() - streamedIndices));
+    bvhNodeStream->append(bvhNodes.data() + streamedBvhNodes, sizeof(BVHNode) * (bvhNodes.size() - streamedBvhNodes));
+}
+
+void Scene::createSSBOs() {
+    TraceScope trace("createSSBOs");
+
+    // the quads and the last model
+    streamGeometry();
+
+    TraceScope finishTrace("finish streamed buffers", vertexStream->size() + indexStream->size() + bvhNodeStream->size());
+    vertexSSBO = vertexStream->finish();
+    indexSSBO = indexStream->finish();
+    bvhNodeSSBO = bvhNodeStream->finish();
+    vertexStream.reset();
+    indexStream.reset();
+    bvhNodeStream.reset();
+    stagingRing.reset();
+    finishTrace.end();
+
+    valid = findGeometryPages();
+
+    sphereSSBO = createSSBO("upload spheres", 2, spheres.data(), sizeof(Sphere) * spheres.size());
+    materialSSBO = createSSBO("upload materials", 5, materials.data(), sizeof(Material) * materials.size());
+    modelInfoSSBO = createSSBO("upload model infos", 7, modelInfos.data(), sizeof(ModelInfo) * modelInfos.size());
+    lightSSBO = createSSBO("upload lights", 13, lights.data(), sizeof(Light) * lights.size());
 
     glGenTextures(1, &thisFrameTex);
     glBindTexture(GL_TEXTURE_2D, thisFrameTex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, nullptr);
 
     glGenTextures(1, &lastFrameTex);
     glBindTexture(GL_TEXTURE_2D, lastFrameTex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, nullptr);
@@ -3,46 +3,135 @@
 
 #include <iostream>
 #include <filesystem>
+#include <memory>
+#include <cstring>
+#include <climits>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "compute_shader.h"
+#include "frame_constants.h"
+#include "wavefront_path_tracer.h"
+#include "adaptive_sampler.h"
+#include "temporal_reprojection.h"
+#include "g_buffer.h"
+#include "denoiser.h"
+#include "shader_features.h"
+#include "traversal_stats.h"
+#include "ray_dump.h"
+#include "ray_replay.h"
+#include "trace_events.h"
+#include "staging_upload.h"
+#include "bvh_refinement.h"
+
+#include "cpu/cpu_traversal.h"
+#include "cpu/cpu_path_tracer.h"
 
 #include "model/model.h"
 #include "model/model_utils.h"
 #include "model/bvh_utils.h"
+#include "model/out_of_core_bvh.h"
 
 
-struct alignas(16) Sphere {
-    glm::vec3 center;
-    float radius;
-    Material material;
-                            
-    Sphere(glm::vec3 center, float radius, Material material) : 
-        center(center), radius(radius), material(material) {
+enum Render_Backend {
+    MEGAKERNEL,
+    WAVEFRONT,
+    CPU
+};
+
+const int MAX_SAMPLES_PER_PIXEL = 64;
+const float MIN_RESOLUTION_SCALE = 0.25f;
+
+// Options of the scene build, from the command line
+struct SceneOptions {
+    // the geometry buffers are paged past this size, or past the largest storage block of the driver when 0
+    long long storageBlockSize = 0;
+    // the models whose PLY file is larger are built out of core within this many bytes, 0 builds every model in memory
+    long long modelMemoryBudget = 0;
+    // the models are added with an LBVH, and their SAH trees are swapped in between two frames once they are built
+    bool progressiveBVH = false;
+};
 
-    }
+struct RenderSettings {
+    Render_Backend backend = MEGAKERNEL;
+    bool sortRays = false;
+    int samplesPerPixel = 5;
+    // only while the frames are accumulated: a pixel stops being traced once the relative
+    // standard error of its accumulated luminance is below adaptiveThreshold
+    bool adaptiveSampling = false;
+    float adaptiveThreshold = 0.02f;
+    // only while the frames are not accumulated: the last frame is reprojected and blended in
+    bool temporalReprojection = true;
+    // filters the frame for display, guided by the G-buffer
+    bool denoise = false;
+    // size of the rendered frame relative to the textures, see DynamicResolution
+    float resolutionScale = 1.0f;
+    // shows the BVH work of every pixel instead of the frame, with the megakernel and CPU backends
+    bool traversalHeatmap = false;
+    Traversal_Metric traversalMetric = AABB_TESTS;
 };
 
 class Scene {
 
 public:
-    ComputeShader computeShader;
-
-    Scene(ComputeShader computeShader, unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT);
+    // The path tracing kernels are compiled for the features of the scene
+    Scene(const char* computeShaderPath, unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT, const SceneOptions& options = SceneOptions());
     ~Scene();
-    GLuint renderScene(glm::vec3 cameraPos, glm::mat4x4 viewMatrix, bool accumulateFrames, int frameCounter);
+    // False when the geometry needs more storage blocks than the driver or the kernels allow, nothing is rendered then
+    bool isValid() const;
+    GLuint renderScene(glm::vec3 cameraPos, glm::mat4x4 viewMatrix, bool accumulateFrames, int frameCounter, const RenderSettings& renderSettings);
+    // Part of the returned texture covered by the last frame
+    glm::vec2 getRenderScale() const;
+    // Reallocates the frame textures for frames of up to width x height, the accumulation must restart
+    void resize(unsigned int width, unsigned int height);
+    // Writes every ray of one frame of the CPU backend (one sample per pixel) to a ray dump
+    bool captureRays(const char* path, glm::vec3 cameraPos, glm::mat4x4 viewMatrix, const RenderSettings& renderSettings);
+    // Traces the rays of a dump of this scene with the GPU and CPU traversals, see RayReplay
+    void replayRays(const char* path, int iterations);
+    // Identifies the geometry and BVH of the scene in the ray dumps
+    unsigned long long sceneHash();
+    // Host and GPU bytes of every scene buffer and of every model
+    void printMemoryReport() const;
+    // Frees the host copies of the geometry once it is uploaded: the vertices, indices and BVH nodes.
+    // They are read back from the GPU buffers when the CPU backend or the ray replay needs them again
+    void releaseHostCopies();
 
 private:
+    std::string computeShaderPath;
+    SceneOptions options;
+    ShaderFeatures shaderFeatures;
+    std::unique_ptr<ComputeShader> computeShader;
+    // the megakernel variant that counts the BVH work, compiled when first used
+    std::unique_ptr<ComputeShader> traversalStatsShader;
+    FrameConstantsBuffer frameConstantsBuffer;
+    // the geometry is uploaded model by model while the scene is built, until createSSBOs
+    std::unique_ptr<StagingRing> stagingRing;
+    std::unique_ptr<StreamedBuffer> vertexStream;
+    std::unique_ptr<StreamedBuffer> indexStream;
+    std::unique_ptr<StreamedBuffer> bvhNodeStream;
+
     GLuint sphereSSBO;
     GLuint vertexSSBO;
     GLuint indexSSBO;
     GLuint materialSSBO;
     GLuint bvhNodeSSBO;
     GLuint modelInfoSSBO;
+    GLuint lightSSBO;
     GLuint thisFrameTex;
     GLuint lastFrameTex;
+    // sequence frame of the reprojected frames
+    int temporalFrame = 0;
+
+    std::unique_ptr<AdaptiveSampler> adaptiveSampler;
+    std::unique_ptr<GBuffer> gBuffer;
+    std::unique_ptr<TemporalReprojection> temporalReprojection;
+    std::unique_ptr<Denoiser> denoiser;
+    std::unique_ptr<TraversalStats> traversalStats;
+    std::unique_ptr<WavefrontPathTracer> wavefrontPathTracer;
+    std::unique_ptr<CpuTraversal> cpuTraversal;
+    std::unique_ptr<CpuPathTracer> cpuPathTracer;
+    std::vector<std::unique_ptr<BVHRefinement>> bvhRefinements;
 
     std::vector<Sphere> spheres;
     std::vector<Vertex> vertices;
@@ -50,14 +139,36 @@ private:
     std::vector<Material> materials;
     std::vector<BVHNode> bvhNodes;
     std::vector<ModelInfo> modelInfos;
+    std::vector<Light> lights;
+    float totalLightArea;
+    bool hostCopiesReleased = false;
+    // the geometry fits in the storage blocks the kernels can bind
+    bool valid = true;
 
     unsigned int SCR_WIDTH;
     unsigned int SCR_HEIGHT;
+    unsigned int renderWidth;
+    unsigned int renderHeight;
+
+    glm::vec3 sceneMin;
+    glm::vec3 sceneMax;
 
     void addQuad(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, glm::vec3 normal, Material material);
     void addModel(const char* modelFilePath, glm::vec3 offset, float scale, float angle, Material material, int maximumNumberOfFacesPerNode);
+    void addModelOutOfCore(const char* modelFilePath, glm::vec3 offset, float scale, float angle, Material material, int maximumNumberOfFacesPerNode);
+    bool loadModelCache(unsigned long long key, Material material);
     void createCornellBox(glm::vec3 center, glm::vec3 size, std::vector<Material> materials);
+    void computeSceneBounds();
+    void collectLights();
     void createSSBOs();
+    void streamGeometry();
+    void bindSceneBuffers();
+    bool findGeometryPages();
+    void bindGeometryPages();
+    void createCpuPathTracer();
+    void restoreHostCopies();
+    void applyBVHRefinements();
+    void findShaderFeatures();
 
     // Scenes
     void testScene();
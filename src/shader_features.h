@@ -0,0 +1,52 @@
+#ifndef SHADER_FEATURES_H
+#define SHADER_FEATURES_H
+
+#include <string>
+#include <vector>
+
+
+// Pages of the geometry buffers, must match geometryPagesCommon.glsl
+const int MAX_GEOMETRY_PAGES = 4;
+const unsigned int VERTEX_PAGE_BINDING = 19;
+const unsigned int INDEX_PAGE_BINDING = 22;
+const unsigned int BVH_NODE_PAGE_BINDING = 25;
+
+// A geometry buffer larger than the largest storage block of the driver is bound as pages of 1 << shift elements
+struct GeometryPaging {
+    int pages = 1;
+    int shift = 0;
+    long long bufferBytes = 0;
+
+    void addDefines(const std::string& prefix, std::vector<std::string>& defines) const {
+        if (pages > 1) {
+            defines.push_back(prefix + "_PAGES " + std::to_string(pages));
+            defines.push_back(prefix + "_PAGE_SHIFT " + std::to_string(shift));
+        }
+    }
+};
+
+// Features of the loaded scene that the path tracing kernels are specialized for, the code of the
+// missing features is left out, the leaf loops get a constant bound and the large buffers are paged. See pathTracingCommon.glsl
+struct ShaderFeatures {
+    bool spheres = true;
+    bool refraction = true;
+    // largest face count of the BVH leaves, 0 when unknown
+    int maxLeafFaces = 0;
+    GeometryPaging vertexPaging;
+    GeometryPaging indexPaging;
+    GeometryPaging bvhNodePaging;
+
+    std::vector<std::string> defines() const {
+        std::vector<std::string> defines = {
+            "HAS_SPHERES " + std::to_string(spheres ? 1 : 0),
+            "HAS_REFRACTION " + std::to_string(refraction ? 1 : 0),
+            "MAX_LEAF_FACES " + std::to_string(maxLeafFaces)
+        };
+        vertexPaging.addDefines("VERTEX", defines);
+        indexPaging.addDefines("INDEX", defines);
+        bvhNodePaging.addDefines("BVH_NODE", defines);
+        return defines;
+    }
+};
+
+#endif
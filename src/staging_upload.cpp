@@ -0,0 +1,151 @@
+#include "staging_upload.h"
+
+#include <cstring>
+
+#include "trace_events.h"
+
+
+GLuint createDeviceBuffer(GLenum target, GLsizeiptr size, const void* data) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+
+    // immutable storage cannot be empty
+    if (GLAD_GL_VERSION_4_4 && size > 0) {
+        glBufferStorage(target, size, data, 0);
+    } else {
+        glBufferData(target, size, data, GL_STATIC_DRAW);
+    }
+    return buffer;
+}
+
+StagingRing::StagingRing() : stagingBuffer(0), mappedChunks(nullptr), fences{}, chunk(0), chunkOffset(0) {
+    if (!GLAD_GL_VERSION_4_4) {
+        return;
+    }
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &stagingBuffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, STAGING_CHUNK_SIZE * STAGING_CHUNK_COUNT, nullptr, flags);
+    mappedChunks = (char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, STAGING_CHUNK_SIZE * STAGING_CHUNK_COUNT, flags);
+}
+
+// The pending copies keep the staging buffer alive until they are done
+StagingRing::~StagingRing() {
+    for (GLsync fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+
+    if (mappedChunks) {
+        glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glDeleteBuffers(1, &stagingBuffer);
+    }
+}
+
+// Fences the copies of the current chunk and waits until the copies out of the next one are done
+void StagingRing::nextChunk() {
+    fences[chunk] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    chunk = (chunk + 1) % STAGING_CHUNK_COUNT;
+    chunkOffset = 0;
+
+    if (fences[chunk]) {
+        TraceScope trace("staging wait");
+        while (glClientWaitSync(fences[chunk], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(fences[chunk]);
+        fences[chunk] = 0;
+    }
+}
+
+void StagingRing::upload(GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size) {
+    TraceScope trace("staging upload", size);
+
+    if (!mappedChunks) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+        return;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        if (chunkOffset == STAGING_CHUNK_SIZE) {
+            nextChunk();
+        }
+
+        GLsizeiptr part = size < STAGING_CHUNK_SIZE - chunkOffset ? size : STAGING_CHUNK_SIZE - chunkOffset;
+        GLintptr stagingOffset = chunk * STAGING_CHUNK_SIZE + chunkOffset;
+        std::memcpy(mappedChunks + stagingOffset, bytes, part);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, stagingOffset, offset, part);
+
+        bytes += part;
+        offset += part;
+        size -= part;
+        chunkOffset += part;
+    }
+}
+
+StreamedBuffer::StreamedBuffer(StagingRing& staging) : staging(staging), buffer(0), capacity(0), used(0) {
+}
+
+StreamedBuffer::~StreamedBuffer() {
+    glDeleteBuffers(1, &buffer);
+}
+
+void StreamedBuffer::append(const void* data, GLsizeiptr size) {
+    if (size == 0) {
+        return;
+    }
+
+    if (used + size > capacity) {
+        GLsizeiptr newCapacity = capacity > 0 ? capacity : STAGING_CHUNK_SIZE;
+        while (newCapacity < used + size) {
+            newCapacity *= 2;
+        }
+
+        // the staging copies into the old buffer were issued before, so the GPU copies them first
+        GLuint grown = createDeviceBuffer(GL_COPY_WRITE_BUFFER, newCapacity, nullptr);
+        if (used > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+        }
+        glDeleteBuffers(1, &buffer);
+        buffer = grown;
+        capacity = newCapacity;
+    }
+
+    staging.upload(buffer, used, data, size);
+    used += size;
+}
+
+GLsizeiptr StreamedBuffer::size() const {
+    return used;
+}
+
+GLuint StreamedBuffer::finish() {
+    if (used == capacity && buffer != 0) {
+        GLuint full = buffer;
+        buffer = 0;
+        capacity = 0;
+        used = 0;
+        return full;
+    }
+
+    GLuint trimmed = createDeviceBuffer(GL_COPY_WRITE_BUFFER, used, nullptr);
+    if (used > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    }
+
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    capacity = 0;
+    used = 0;
+    return trimmed;
+}
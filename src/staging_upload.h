@@ -0,0 +1,56 @@
+#ifndef STAGING_UPLOAD_H
+#define STAGING_UPLOAD_H
+
+#include "../dependencies/glad.h"
+
+
+// The uploads are split into chunks of this size, one chunk is written while the others are copied
+const GLsizeiptr STAGING_CHUNK_SIZE = 4 << 20;
+const int STAGING_CHUNK_COUNT = 4;
+
+// Creates a buffer that only the GPU writes from then on: immutable storage where glBufferStorage is available (GL 4.4)
+GLuint createDeviceBuffer(GLenum target, GLsizeiptr size, const void* data);
+
+// Ring of staging chunks in one persistently mapped buffer (GL 4.4). The data is copied into a chunk on the CPU
+// and from there into the destination buffer on the GPU, a chunk is only written again after the fence of its copies.
+// Without GL 4.4 the data goes straight to the destination with glBufferSubData
+class StagingRing {
+public:
+    StagingRing();
+    ~StagingRing();
+
+    // Copies size bytes of data to offset of buffer, returns before the GPU copied them
+    void upload(GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size);
+
+private:
+    GLuint stagingBuffer;
+    // null without persistent mapping
+    char* mappedChunks;
+    GLsync fences[STAGING_CHUNK_COUNT];
+    int chunk;
+    GLsizeiptr chunkOffset;
+
+    void nextChunk();
+};
+
+// A device buffer filled by appending through a StagingRing, while the data is produced.
+// It doubles its capacity with a GPU copy when it is full, and finish trims it to its content
+class StreamedBuffer {
+public:
+    StreamedBuffer(StagingRing& staging);
+    ~StreamedBuffer();
+
+    void append(const void* data, GLsizeiptr size);
+    // Bytes appended so far
+    GLsizeiptr size() const;
+    // Returns a buffer of exactly size() bytes, owned by the caller from then on
+    GLuint finish();
+
+private:
+    StagingRing& staging;
+    GLuint buffer;
+    GLsizeiptr capacity;
+    GLsizeiptr used;
+};
+
+#endif
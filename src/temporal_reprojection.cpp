@@ -0,0 +1,55 @@
+#include "temporal_reprojection.h"
+
+
+GLint64 TemporalReprojection::gpuBytes(unsigned int width, unsigned int height) {
+    return 2 * (GLint64)sizeof(glm::vec4) * width * height;
+}
+
+TemporalReprojection::TemporalReprojection(unsigned int width, unsigned int height) :
+    resolveShader("../shaders/temporalReprojectionShader.comp"), currentMoments(0), hasHistory(false), 
+    previousViewMatrix(1.0f), previousCameraPosition(0.0f) {
+
+    glGenTextures(2, momentsTex);
+    for (GLuint texture : momentsTex) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    }
+}
+
+TemporalReprojection::~TemporalReprojection() {
+    glDeleteTextures(2, momentsTex);
+}
+
+void TemporalReprojection::resolve(const FrameConstants& frameConstants, GLuint thisFrameTex, GLuint lastFrameTex) {
+    currentMoments = 1 - currentMoments;
+
+    glBindImageTexture(0, thisFrameTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(1, lastFrameTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+    glBindImageTexture(6, momentsTex[currentMoments], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glBindImageTexture(7, momentsTex[1 - currentMoments], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+
+    // the samples and the G-buffer of this frame must be visible to the resolve
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    resolveShader.use();
+    resolveShader.setMat4("previousViewMatrix", previousViewMatrix);
+    resolveShader.setVec3("previousCameraPosition", previousCameraPosition);
+    resolveShader.setBool("hasHistory", hasHistory);
+    resolveShader.dispatchImage(frameConstants.width, frameConstants.height);
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    hasHistory = true;
+    previousViewMatrix = frameConstants.viewMatrix;
+    previousCameraPosition = frameConstants.cameraPosition;
+}
+
+void TemporalReprojection::reset() {
+    hasHistory = false;
+}
+
+GLuint TemporalReprojection::momentsTexture() const {
+    return momentsTex[currentMoments];
+}
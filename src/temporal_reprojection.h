@@ -0,0 +1,39 @@
+#ifndef TEMPORAL_REPROJECTION_H
+#define TEMPORAL_REPROJECTION_H
+
+#include <glm/glm.hpp>
+
+#include "compute_shader.h"
+#include "frame_constants.h"
+
+
+// Blends the last frame, reprojected through the last camera, into the new samples while the frames
+// are not accumulated. A previous pixel is only reused when its G-buffer entry saw the same surface.
+class TemporalReprojection {
+public:
+    // width x height: the largest frame
+    TemporalReprojection(unsigned int width, unsigned int height);
+    ~TemporalReprojection();
+    // GPU bytes the constructor allocates for width x height
+    static GLint64 gpuBytes(unsigned int width, unsigned int height);
+
+    // Replaces the samples in thisFrameTex with their blend with the history in lastFrameTex,
+    // the G-buffers of both frames must be bound already (see GBuffer::bind)
+    void resolve(const FrameConstants& frameConstants, GLuint thisFrameTex, GLuint lastFrameTex);
+    // Drops the history, the next frame starts from its own samples. Needed whenever the frame size changes
+    void reset();
+    // Luminance moments over the history of the last resolve
+    GLuint momentsTexture() const;
+
+private:
+    ComputeShader resolveShader;
+
+    GLuint momentsTex[2];
+    int currentMoments;
+
+    bool hasHistory;
+    glm::mat4 previousViewMatrix;
+    glm::vec3 previousCameraPosition;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <string>
+
+#include "../../dependencies/glad.h"
+#include <GLFW/glfw3.h>
+
+#include "../compute_shader.h"
+#include "../scene.h"
+
+
+// Replays a ray dump captured with the C key of the path tracer, in the same scene:
+// RayReplay <ray_dump.bin> [<iterations>]
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        std::cout << "Usage: " << argv[0] << " <ray_dump.bin> [<iterations>]" << std::endl;
+        return -1;
+    }
+    int iterations = argc == 3 ? std::stoi(argv[2]) : 5;
+
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(1, 1, "Ray replay", NULL, NULL);
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    {
+        // no frame is rendered, the frame textures only need to exist
+        Scene scene("../shaders/pathTracingShader.comp", 1, 1);
+        scene.replayRays(argv[1], iterations);
+    }
+
+    ComputeShader::deleteCachedPrograms();
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "trace_events.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+
+std::atomic<bool> TraceEvents::recording(false);
+std::mutex TraceEvents::mutex;
+std::string TraceEvents::path;
+std::chrono::steady_clock::time_point TraceEvents::origin;
+std::vector<TraceEvents::Event> TraceEvents::events;
+size_t TraceEvents::droppedEvents = 0;
+std::unordered_map<std::thread::id, int> TraceEvents::threadIndices;
+
+void TraceEvents::start(const std::string& tracePath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    path = tracePath;
+    origin = std::chrono::steady_clock::now();
+    events.clear();
+    droppedEvents = 0;
+    threadIndices.clear();
+    threadIndices[std::this_thread::get_id()] = 0;
+    recording = true;
+}
+
+bool TraceEvents::isRecording() {
+    return recording;
+}
+
+void TraceEvents::addEvent(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!recording) {
+        return;
+    }
+
+    if (events.size() >= TRACE_MAX_EVENTS) {
+        droppedEvents++;
+        return;
+    }
+
+    auto thread = threadIndices.emplace(std::this_thread::get_id(), (int)threadIndices.size()).first;
+    events.push_back({ name, std::chrono::duration<double, std::micro>(start - origin).count(), 
+                       std::chrono::duration<double, std::micro>(end - start).count(), thread->second, bytes });
+}
+
+// The names are code identifiers, only quotes and backslashes need escaping
+static std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+void TraceEvents::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!recording) {
+        return;
+    }
+    recording = false;
+
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "Could not write the trace " << path << std::endl;
+        return;
+    }
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (const auto& [id, index] : threadIndices) {
+        std::string threadName = index == 0 ? "main" : "thread " + std::to_string(index);
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << index << ",\"args\":{\"name\":\"" << threadName << "\"}},\n";
+    }
+
+    for (size_t i = 0; i < events.size(); i++) {
+        const Event& event = events[i];
+        file << "{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+             << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs << ",\"args\":{\"bytes\":" << event.bytes << "}}"
+             << (i + 1 < events.size() ? ",\n" : "\n");
+    }
+    file << "]}\n";
+
+    std::cout << "Wrote " << events.size() << " trace events to " << path;
+    if (droppedEvents > 0) {
+        std::cout << ", " << droppedEvents << " events past the first " << TRACE_MAX_EVENTS << " were dropped";
+    }
+    std::cout << std::endl;
+}
+
+TraceScope::TraceScope(const char* name, size_t bytes) : name(name), bytes(bytes), active(TraceEvents::isRecording()) {
+    if (active) {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+TraceScope::~TraceScope() {
+    end();
+}
+
+void TraceScope::setBytes(size_t eventBytes) {
+    bytes = eventBytes;
+}
+
+void TraceScope::end() {
+    if (active) {
+        TraceEvents::addEvent(name, start, std::chrono::steady_clock::now(), bytes);
+        active = false;
+    }
+}
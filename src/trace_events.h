@@ -0,0 +1,64 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+// Events past this many are dropped, so a long session cannot grow the trace without bound
+const size_t TRACE_MAX_EVENTS = 1 << 20;
+
+// CPU phases written as a Chrome trace event JSON file, for chrome://tracing or ui.perfetto.dev.
+// Every event is a complete event ("ph": "X") on the row of the thread that recorded it, with its byte count in its args.
+class TraceEvents {
+public:
+    // Starts recording, the calling thread is named "main"
+    static void start(const std::string& path);
+    // Writes the events recorded since start
+    static void stop();
+    static bool isRecording();
+    static void addEvent(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, size_t bytes);
+
+private:
+    struct Event {
+        std::string name;
+        double startUs;
+        double durationUs;
+        int thread;
+        size_t bytes;
+    };
+
+    static std::atomic<bool> recording;
+    static std::mutex mutex;
+    static std::string path;
+    static std::chrono::steady_clock::time_point origin;
+    static std::vector<Event> events;
+    static size_t droppedEvents;
+    // small numbers for the rows of the trace, in the order the threads first recorded an event
+    static std::unordered_map<std::thread::id, int> threadIndices;
+};
+
+// Records its lifetime as an event, or nothing when the trace is not recording.
+// name must outlive the scope, it is only copied when the event is recorded
+class TraceScope {
+public:
+    TraceScope(const char* name, size_t bytes = 0);
+    ~TraceScope();
+
+    void setBytes(size_t bytes);
+    // Ends the event before the end of the scope
+    void end();
+
+private:
+    const char* name;
+    size_t bytes;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "traversal_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+
+GLint64 TraversalStats::gpuBytes(unsigned int width, unsigned int height) {
+    return (GLint64)sizeof(glm::uvec4) * width * height + (GLint64)sizeof(glm::vec4) * width * height;
+}
+
+TraversalStats::TraversalStats(unsigned int width, unsigned int height) : 
+    heatmapShader("../shaders/traversalHeatmapShader.comp"), costs(width * height), frames(0) {
+
+    glGenBuffers(1, &costSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, costSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::uvec4) * width * height, nullptr, GL_DYNAMIC_COPY);
+
+    glGenTextures(1, &heatmapTex);
+    glBindTexture(GL_TEXTURE_2D, heatmapTex);
+    // the heatmap is upscaled like the frame, without blending the costs of neighbouring pixels
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+}
+
+TraversalStats::~TraversalStats() {
+    glDeleteBuffers(1, &costSSBO);
+    glDeleteTextures(1, &heatmapTex);
+}
+
+void TraversalStats::bind(const FrameConstants& frameConstants) {
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, costSSBO);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, sizeof(glm::uvec4) * frameConstants.width * frameConstants.height,
+                         GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, costSSBO);
+}
+
+void TraversalStats::upload(const FrameConstants& frameConstants, const std::vector<glm::uvec4>& costs) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, costSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::uvec4) * frameConstants.width * frameConstants.height, costs.data());
+}
+
+GLuint TraversalStats::resolve(const FrameConstants& frameConstants, Traversal_Metric metric) {
+    int pixelCount = frameConstants.width * frameConstants.height;
+
+    // a debug view, so reading the counters back is allowed to wait for the frame
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, costSSBO);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::uvec4) * pixelCount, costs.data());
+
+    double mean[3];
+    double total[3];
+    unsigned int percentile[3];
+    std::vector<unsigned int> values(pixelCount);
+
+    for (int component = 0; component < 3; component++) {
+        total[component] = 0;
+        for (int i = 0; i < pixelCount; i++) {
+            values[i] = costs[i][component];
+            total[component] += values[i];
+        }
+        mean[component] = total[component] / pixelCount;
+
+        int rank = glm::min(pixelCount - 1, (int)(0.99 * pixelCount));
+        std::nth_element(values.begin(), values.begin() + rank, values.end());
+        percentile[component] = values[rank];
+    }
+
+    if (frames++ % TRAVERSAL_STATS_REPORT_FRAMES == 0) {
+        const char* names[] = { "nodes visited", "AABB tests", "triangle tests" };
+        std::cout << "Traversal cost per pixel, " << frameConstants.width << " x " << frameConstants.height << " pixels" << std::endl;
+        std::cout << "cost           |       mean |        p99 |      total" << std::endl;
+
+        for (int component = 0; component < 3; component++) {
+            char line[128];
+            std::snprintf(line, sizeof(line), "%-14s | %10.1f | %10u | %10.0f", names[component], mean[component], percentile[component], total[component]);
+            std::cout << line << std::endl;
+        }
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, costSSBO);
+    glBindImageTexture(0, heatmapTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+    heatmapShader.use();
+    heatmapShader.setInt("heatmapMetric", metric);
+    heatmapShader.setFloat("heatmapScale", (float)glm::max(1u, percentile[metric]));
+    heatmapShader.dispatchImage(frameConstants.width, frameConstants.height);
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    return heatmapTex;
+}
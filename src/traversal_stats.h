@@ -0,0 +1,49 @@
+#ifndef TRAVERSAL_STATS_H
+#define TRAVERSAL_STATS_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "compute_shader.h"
+#include "frame_constants.h"
+
+
+// Components of the per pixel traversal cost, see traversalStatsCommon.glsl
+enum Traversal_Metric {
+    NODES_VISITED,
+    AABB_TESTS,
+    TRIANGLE_TESTS
+};
+
+// The statistics of the current frame are printed every TRAVERSAL_STATS_REPORT_FRAMES frames
+const int TRAVERSAL_STATS_REPORT_FRAMES = 30;
+
+// BVH work of every pixel over all the rays of its samples (camera, bounce and shadow rays),
+// shown as a false color heatmap and summed up as the mean, 99th percentile and total per frame.
+// Counted by the TRAVERSAL_STATS variant of the megakernel or by the CPU backend.
+class TraversalStats {
+public:
+    // width x height: the largest frame
+    TraversalStats(unsigned int width, unsigned int height);
+    ~TraversalStats();
+    // GPU bytes the constructor allocates for width x height
+    static GLint64 gpuBytes(unsigned int width, unsigned int height);
+
+    // Clears the counters of the frame and binds them (SSBO 16), before the frame is traced
+    void bind(const FrameConstants& frameConstants);
+    // The counters of the frame when the CPU backend traced it
+    void upload(const FrameConstants& frameConstants, const std::vector<glm::uvec4>& costs);
+    // Returns the heatmap of metric, blue for no work up to red for its 99th percentile and above
+    GLuint resolve(const FrameConstants& frameConstants, Traversal_Metric metric);
+
+private:
+    ComputeShader heatmapShader;
+
+    GLuint costSSBO;
+    GLuint heatmapTex;
+    std::vector<glm::uvec4> costs;
+    int frames;
+};
+
+#endif
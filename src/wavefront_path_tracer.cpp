@@ -0,0 +1,203 @@
+#include "wavefront_path_tracer.h"
+
+
+GLint64 WavefrontPathTracer::gpuBytes(unsigned int width, unsigned int height) {
+    GLint64 queueCapacity = (GLint64)width * height;
+    return (sizeof(PathState) + sizeof(QueuedRay) * 2 + sizeof(HitRecord) + sizeof(ShadowRay)) * queueCapacity 
+         + sizeof(WavefrontCounters) + sizeof(unsigned int) * RAY_SORT_BIN_COUNT * 2;
+}
+
+WavefrontPathTracer::WavefrontPathTracer(unsigned int width, unsigned int height, const std::vector<std::string>& defines) : 
+    generateShader("../shaders/wavefrontGenerateShader.comp", defines),
+    dispatchShader("../shaders/wavefrontDispatchShader.comp", defines),
+    intersectShader("../shaders/wavefrontIntersectShader.comp", defines),
+    shadeShader("../shaders/wavefrontShadeShader.comp", defines),
+    shadowShader("../shaders/wavefrontShadowShader.comp", defines),
+    accumulateShader("../shaders/wavefrontAccumulateShader.comp", defines),
+    sortHistogramShader("../shaders/wavefrontSortHistogramShader.comp"),
+    sortScanShader("../shaders/wavefrontSortScanShader.comp"),
+    sortScatterShader("../shaders/wavefrontSortScatterShader.comp"),
+    queriesPending{ false, false }, queriesSorted{ false, false }, queriesSamples{ 0, 0 }, querySet(0), raySortingStats("wavefront"),
+    queueCapacity(width * height) {
+
+    glGenBuffers(1, &pathStateSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pathStateSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(PathState) * queueCapacity, nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &rayQueueSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayQueueSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(QueuedRay) * queueCapacity * 2, nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &hitSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, hitSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(HitRecord) * queueCapacity, nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &shadowRaySSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, shadowRaySSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ShadowRay) * queueCapacity, nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &counterSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(WavefrontCounters), nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &rayBinSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayBinSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * RAY_SORT_BIN_COUNT * 2, nullptr, GL_DYNAMIC_COPY);
+
+    glGenQueries(WAVEFRONT_TIMED_SAMPLES * WAVEFRONT_MAX_DEPTH * 2, &sortQueries[0][0]);
+    glGenQueries(WAVEFRONT_TIMED_SAMPLES * WAVEFRONT_MAX_DEPTH * 2, &traceQueries[0][0]);
+}
+
+WavefrontPathTracer::~WavefrontPathTracer() {
+    glDeleteBuffers(1, &pathStateSSBO);
+    glDeleteBuffers(1, &rayQueueSSBO);
+    glDeleteBuffers(1, &hitSSBO);
+    glDeleteBuffers(1, &shadowRaySSBO);
+    glDeleteBuffers(1, &counterSSBO);
+    glDeleteBuffers(1, &rayBinSSBO);
+
+    glDeleteQueries(WAVEFRONT_TIMED_SAMPLES * WAVEFRONT_MAX_DEPTH * 2, &sortQueries[0][0]);
+    glDeleteQueries(WAVEFRONT_TIMED_SAMPLES * WAVEFRONT_MAX_DEPTH * 2, &traceQueries[0][0]);
+}
+
+void WavefrontPathTracer::render(const FrameConstants& frameConstants, bool sortRays, GLuint activePixelSSBO) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, pathStateSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, rayQueueSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, hitSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, counterSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, rayBinSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, shadowRaySSBO);
+
+    ComputeShader* stages[] = { &generateShader, &dispatchShader, &intersectShader, &shadeShader, &shadowShader, &accumulateShader,
+                                &sortHistogramShader, &sortScanShader, &sortScatterShader };
+    for (ComputeShader* stage : stages) {
+        stage->use();
+        stage->setInt("queueCapacity", queueCapacity);
+    }
+
+    querySet = 1 - querySet;
+    if (queriesPending[querySet]) {
+        collectTimings(querySet);
+    }
+
+    int timedSamples = glm::min(frameConstants.samplesPerPixel, WAVEFRONT_TIMED_SAMPLES);
+
+    for (int sample = 0; sample < frameConstants.samplesPerPixel; sample++) {
+        bool timed = sample < timedSamples;
+
+        // every pixel starts a path, so the first queue is full, 
+        // unless only the active pixels do (the generate stage then sets the count)
+        unsigned int firstQueueCount = frameConstants.adaptiveSampling ? 0 : frameConstants.width * frameConstants.height;
+        WavefrontCounters counters = { 0, 1, 1, { firstQueueCount, 0 }, 0 };
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterSSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(WavefrontCounters), &counters);
+
+        generateShader.use();
+        generateShader.setInt("sampleIndex", sample);
+        if (frameConstants.adaptiveSampling) {
+            generateShader.dispatchIndirect(activePixelSSBO);
+        } else {
+            generateShader.dispatchImage(frameConstants.width, frameConstants.height);
+        }
+
+        int currentQueue = 0;
+        for (int depth = 0; depth < WAVEFRONT_MAX_DEPTH; depth++) {
+            int query = sample * WAVEFRONT_MAX_DEPTH + depth;
+
+            dispatchShader.use();
+            dispatchShader.setInt("currentQueue", currentQueue);
+            dispatchShader.dispatch(1, 1, 1);
+            glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+            // camera rays are coherent already
+            if (sortRays && depth > 0) {
+                if (timed) {
+                    glBeginQuery(GL_TIME_ELAPSED, sortQueries[querySet][query]);
+                }
+                sortRayQueue(currentQueue);
+                currentQueue = 1 - currentQueue;
+
+                dispatchShader.use();
+                dispatchShader.setInt("currentQueue", currentQueue);
+                dispatchShader.dispatch(1, 1, 1);
+                glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+                if (timed) {
+                    glEndQuery(GL_TIME_ELAPSED);
+                }
+            }
+
+            if (timed) {
+                glBeginQuery(GL_TIME_ELAPSED, traceQueries[querySet][query]);
+            }
+
+            intersectShader.use();
+            intersectShader.setInt("currentQueue", currentQueue);
+            intersectShader.dispatchIndirect(counterSSBO);
+
+            shadeShader.use();
+            shadeShader.setInt("currentQueue", currentQueue);
+            shadeShader.setInt("depth", depth);
+            shadeShader.setInt("sampleIndex", sample);
+            shadeShader.dispatchIndirect(counterSSBO);
+
+            // the shadow queue is never longer than the current queue, so its dispatch size still fits
+            shadowShader.dispatchIndirect(counterSSBO);
+
+            if (timed) {
+                glEndQuery(GL_TIME_ELAPSED);
+            }
+
+            currentQueue = 1 - currentQueue;
+        }
+    }
+
+    queriesPending[querySet] = true;
+    queriesSorted[querySet] = sortRays;
+    queriesSamples[querySet] = timedSamples;
+
+    accumulateShader.dispatchImage(frameConstants.width, frameConstants.height);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+// Bins the current queue into the other one, the dispatch size must be up to date
+void WavefrontPathTracer::sortRayQueue(int currentQueue) {
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayBinSSBO);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, sizeof(unsigned int) * RAY_SORT_BIN_COUNT, 
+                         GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    sortHistogramShader.use();
+    sortHistogramShader.setInt("currentQueue", currentQueue);
+    sortHistogramShader.dispatchIndirect(counterSSBO);
+
+    sortScanShader.use();
+    sortScanShader.setInt("currentQueue", currentQueue);
+    sortScanShader.dispatch(1, 1, 1);
+
+    sortScatterShader.use();
+    sortScatterShader.setInt("currentQueue", currentQueue);
+    sortScatterShader.dispatchIndirect(counterSSBO);
+}
+
+void WavefrontPathTracer::collectTimings(int set) {
+    bool sorted = queriesSorted[set];
+
+    for (int sample = 0; sample < queriesSamples[set]; sample++) {
+        for (int depth = 0; depth < WAVEFRONT_MAX_DEPTH; depth++) {
+            int query = sample * WAVEFRONT_MAX_DEPTH + depth;
+
+            GLuint64 sortNs = 0;
+            GLuint64 traceNs = 0;
+            if (sorted && depth > 0) {
+                glGetQueryObjectui64v(sortQueries[set][query], GL_QUERY_RESULT, &sortNs);
+            }
+            glGetQueryObjectui64v(traceQueries[set][query], GL_QUERY_RESULT, &traceNs);
+
+            raySortingStats.addBounce(sorted, depth, sortNs / 1e6, traceNs / 1e6);
+        }
+    }
+
+    raySortingStats.endFrame(sorted);
+    queriesPending[set] = false;
+}
@@ -0,0 +1,104 @@
+#ifndef WAVEFRONT_PATH_TRACER_H
+#define WAVEFRONT_PATH_TRACER_H
+
+#include <glm/glm.hpp>
+
+#include "compute_shader.h"
+#include "frame_constants.h"
+#include "ray_sorting.h"
+
+#include "model/model.h"
+
+
+// Must match MAX_DEPTH of pathTracingCommon.glsl
+const int WAVEFRONT_MAX_DEPTH = 10;
+// Only the bounces of the first samples of a frame are timed
+const int WAVEFRONT_TIMED_SAMPLES = 8;
+// Storage blocks of the wavefront kernels that declare the most, without the geometry pages. Counted from
+// wavefrontGenerateShader.comp: the 7 blocks of pathTracingCommon.glsl it uses, the 5 of wavefrontCommon.glsl
+// and the active pixels of adaptiveSamplingCommon.glsl (the sort kernels have the ray bins instead). Every
+// geometry page adds one. Must follow the blocks of wavefrontCommon.glsl
+const int WAVEFRONT_STORAGE_BLOCKS = 13;
+
+// std430 mirrors of the structs in wavefrontCommon.glsl
+struct alignas(16) PathState {
+    glm::vec3 color;
+    float lastBsdfPdf;
+    glm::vec3 radiance;
+    float pad;
+};
+
+struct alignas(16) QueuedRay {
+    glm::vec3 origin;
+    int pathIndex;
+    glm::vec3 direction;
+    int pad;
+};
+
+struct alignas(16) ShadowRay {
+    glm::vec3 origin;
+    float dist;
+    glm::vec3 direction;
+    int pathIndex;
+    glm::vec3 contribution;
+    float pad;
+};
+
+struct WavefrontCounters {
+    unsigned int numGroupsX;
+    unsigned int numGroupsY;
+    unsigned int numGroupsZ;
+    unsigned int queueCount[2];
+    unsigned int shadowQueueCount;
+};
+
+// Multi-kernel path tracer: the bounces of all pixels advance together, stage by stage,
+// with the surviving rays compacted into a queue between the bounces.
+class WavefrontPathTracer {
+
+public:
+    // width x height: the largest frame. The path tracing stages are compiled with defines, see ShaderFeatures
+    WavefrontPathTracer(unsigned int width, unsigned int height, const std::vector<std::string>& defines = {});
+    ~WavefrontPathTracer();
+    // GPU bytes the constructor allocates for width x height
+    static GLint64 gpuBytes(unsigned int width, unsigned int height);
+
+    // Expects the scene buffers and the frame images to be bound already
+    // With adaptive sampling, the paths start from the pixels of activePixelSSBO (see AdaptiveSampler)
+    void render(const FrameConstants& frameConstants, bool sortRays, GLuint activePixelSSBO);
+
+private:
+    ComputeShader generateShader;
+    ComputeShader dispatchShader;
+    ComputeShader intersectShader;
+    ComputeShader shadeShader;
+    ComputeShader shadowShader;
+    ComputeShader accumulateShader;
+    ComputeShader sortHistogramShader;
+    ComputeShader sortScanShader;
+    ComputeShader sortScatterShader;
+
+    GLuint pathStateSSBO;
+    GLuint rayQueueSSBO;
+    GLuint hitSSBO;
+    GLuint shadowRaySSBO;
+    GLuint counterSSBO;
+    GLuint rayBinSSBO;
+
+    // Two sets of GL_TIME_ELAPSED queries, a set is read back two frames after it was issued
+    GLuint sortQueries[2][WAVEFRONT_TIMED_SAMPLES * WAVEFRONT_MAX_DEPTH];
+    GLuint traceQueries[2][WAVEFRONT_TIMED_SAMPLES * WAVEFRONT_MAX_DEPTH];
+    bool queriesPending[2];
+    bool queriesSorted[2];
+    int queriesSamples[2];
+    int querySet;
+    RaySortingStats raySortingStats;
+
+    // one path per pixel of the largest frame
+    unsigned int queueCapacity;
+
+    void sortRayQueue(int currentQueue);
+    void collectTimings(int set);
+};
+
+#endif